@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The queue is internal, only the elements count as blocks of the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "bq.h"
+
+/* Elements are linked through element_t.list, everything under one lock.
+ * The waiting counters spare a wakeup call when nobody is parked.
+ */
+struct bq {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+    struct list_head head;
+    size_t size, cap;
+    int waiting_cons, waiting_prod;
+};
+
+bq_t *bq_new(size_t cap)
+{
+    bq_t *q = malloc(sizeof(bq_t));
+    if (!q)
+        return NULL;
+    /* Timeouts are measured on the monotonic clock, immune to clock jumps */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, &attr);
+    pthread_cond_init(&q->not_full, NULL);
+    pthread_condattr_destroy(&attr);
+    INIT_LIST_HEAD(&q->head);
+    q->size = 0;
+    q->cap = cap;
+    q->waiting_cons = q->waiting_prod = 0;
+    return q;
+}
+
+void bq_free(bq_t *q)
+{
+    if (!q)
+        return;
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, &q->head, list)
+        q_release_element(e);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+bool bq_insert_tail(bq_t *q, char *s)
+{
+    if (!(q && s))
+        return false;
+    element_t *e = q_new_element(s);
+    if (!e)
+        return false;
+    bq_insert_element(q, e);
+    return true;
+}
+
+bool bq_insert_element(bq_t *q, element_t *e)
+{
+    if (!(q && e))
+        return false;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->cap && q->size >= q->cap) {
+        q->waiting_prod++;
+        pthread_cond_wait(&q->not_full, &q->lock);
+        q->waiting_prod--;
+    }
+    list_add_tail(&e->list, &q->head);
+    q->size++;
+    /* One element is enough for one consumer */
+    if (q->waiting_cons)
+        pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+element_t *bq_remove_head(bq_t *q, char *sp, size_t bufsize, int timeout_ms)
+{
+    if (!q)
+        return NULL;
+
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&q->lock);
+    while (!q->size) {
+        q->waiting_cons++;
+        int err = timeout_ms < 0 ? pthread_cond_wait(&q->not_empty, &q->lock)
+                                 : pthread_cond_timedwait(&q->not_empty,
+                                                          &q->lock, &deadline);
+        q->waiting_cons--;
+        /* An element that came in together with the timeout is still taken,
+         * the wakeup meant for it may have been spent on this thread
+         */
+        if (err == ETIMEDOUT)
+            break;
+    }
+    if (!q->size) {
+        pthread_mutex_unlock(&q->lock);
+        return NULL;
+    }
+    element_t *e = list_first_entry(&q->head, element_t, list);
+    list_del(&e->list);
+    q->size--;
+    if (q->waiting_prod)
+        pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+
+    if (sp) {
+        size_t len = strnlen(e->value, bufsize - 1);
+        memcpy(sp, e->value, len);
+        sp[len] = 0;
+    }
+    return e;
+}
@@ -0,0 +1,71 @@
+#ifndef LAB0_BQ_H
+#define LAB0_BQ_H
+
+/* Blocking FIFO queue of elements.
+ *
+ * Removing from an empty queue parks the caller until an element arrives or
+ * a timeout expires; with a capacity, inserting into a full queue parks the
+ * caller until there is room. Each insert or remove wakes at most one
+ * parked thread, and only if one is parked.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+typedef struct bq bq_t;
+
+/**
+ * bq_new() - Create an empty queue
+ * @cap: most elements the queue holds, 0 for no limit
+ *
+ * Return: NULL for allocation failed
+ */
+bq_t *bq_new(size_t cap);
+
+/**
+ * bq_free() - Free the queue and the elements still in it
+ * @q: queue, no effect if NULL
+ *
+ * No thread may be using or waiting on the queue any more.
+ */
+void bq_free(bq_t *q);
+
+/**
+ * bq_insert_tail() - Insert a copy of a string at the tail
+ * @q: queue
+ * @s: string to be stored
+ *
+ * Waits for room if the queue is full.
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool bq_insert_tail(bq_t *q, char *s);
+
+/**
+ * bq_insert_element() - Insert an element made by the caller at the tail
+ * @q: queue
+ * @e: element from q_new_element(), owned by the queue on success
+ *
+ * Waits for room if the queue is full.
+ *
+ * Return: true for success, false for NULL arguments
+ */
+bool bq_insert_element(bq_t *q, element_t *e);
+
+/**
+ * bq_remove_head() - Remove the element at the head
+ * @q: queue
+ * @sp: buffer to copy the removed string to, or NULL
+ * @bufsize: size of @sp
+ * @timeout_ms: longest time to wait for an element, negative to wait
+ *              for as long as it takes
+ *
+ * Same ownership as q_remove_head().
+ *
+ * Return: the element removed, NULL if the queue is NULL or the timeout
+ * expired
+ */
+element_t *bq_remove_head(bq_t *q, char *sp, size_t bufsize, int timeout_ms);
+
+#endif /* LAB0_BQ_H */
@@ -0,0 +1,107 @@
+/* Chase and Lev, "Dynamic Circular Work-Stealing Deque", SPAA 2005, with
+ * the memory orders of Le, Pop, Cohen and Zappa Nardelli, "Correct and
+ * Efficient Work-Stealing for Weak Memory Models", PPoPP 2013.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* The deque is internal, not a block handed to the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "deque.h"
+
+#define CACHE_LINE 64
+
+struct deque {
+    _Alignas(CACHE_LINE) atomic_long top;    /* thieves */
+    _Alignas(CACHE_LINE) atomic_long bottom; /* owner */
+    _Alignas(CACHE_LINE) long mask;
+    void *_Atomic *buf;
+};
+
+deque_t *deque_new(size_t cap)
+{
+    if (!cap || cap > ((size_t) -1 >> 2))
+        return NULL;
+    size_t n = 1;
+    while (n < cap)
+        n <<= 1;
+    deque_t *d = aligned_alloc(CACHE_LINE, sizeof(deque_t));
+    void *_Atomic *buf = malloc(n * sizeof(*buf));
+    if (!d || !buf) {
+        free(d);
+        free(buf);
+        return NULL;
+    }
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    d->mask = n - 1;
+    d->buf = buf;
+    return d;
+}
+
+void deque_free(deque_t *d)
+{
+    if (!d)
+        return;
+    free(d->buf);
+    free(d);
+}
+
+bool deque_push(deque_t *d, void *p)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t > d->mask)
+        return false;
+    atomic_store_explicit(&d->buf[b & d->mask], p, memory_order_relaxed);
+    /* Release: a thief that sees the new bottom sees the entry and
+     * whatever it points to
+     */
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+/* Stores to bottom are all releases, so that a thief synchronizes with the
+ * push of the entry it takes whichever store of bottom it reads
+ */
+void *deque_pop(deque_t *d)
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    void *p = NULL;
+    if (t <= b) {
+        p = atomic_load_explicit(&d->buf[b & d->mask], memory_order_relaxed);
+        if (t == b) {
+            /* Last entry, race the thieves for it */
+            if (!atomic_compare_exchange_strong_explicit(
+                    &d->top, &t, t + 1, memory_order_seq_cst,
+                    memory_order_relaxed))
+                p = NULL;
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    }
+    return p;
+}
+
+void *deque_steal(deque_t *d)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+        return NULL;
+    void *p = atomic_load_explicit(&d->buf[t & d->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return NULL;
+    return p;
+}
@@ -0,0 +1,57 @@
+#ifndef LAB0_DEQUE_H
+#define LAB0_DEQUE_H
+
+/* Chase-Lev work-stealing deque of pointers.
+ *
+ * The owner thread pushes and pops at the bottom with no atomic
+ * read-modify-write except when the deque is down to one entry; any other
+ * thread may steal from the top. The capacity is fixed, so entries never
+ * move and no memory has to be reclaimed.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct deque deque_t;
+
+/**
+ * deque_new() - Create an empty deque
+ * @cap: number of entries, rounded up to a power of two
+ *
+ * Return: NULL for allocation failed or @cap of zero
+ */
+deque_t *deque_new(size_t cap);
+
+/**
+ * deque_free() - Free the deque, not what its entries point to
+ * @d: deque, no effect if NULL
+ */
+void deque_free(deque_t *d);
+
+/**
+ * deque_push() - Push an entry at the bottom, owner only
+ * @d: deque
+ * @p: entry, not NULL
+ *
+ * Return: false if the deque is full
+ */
+bool deque_push(deque_t *d, void *p);
+
+/**
+ * deque_pop() - Pop the entry pushed last, owner only
+ * @d: deque
+ *
+ * Return: the entry, NULL if the deque is empty
+ */
+void *deque_pop(deque_t *d);
+
+/**
+ * deque_steal() - Take the entry pushed first, any thread
+ * @d: deque
+ *
+ * Return: the entry, NULL if the deque is empty or another thread took the
+ * entry first
+ */
+void *deque_steal(deque_t *d);
+
+#endif /* LAB0_DEQUE_H */
@@ -0,0 +1,190 @@
+/* Treiber, "Systems Programming: Coping with Parallelism", IBM RJ 5118,
+ * 1986; elimination after Hendler, Shavit and Yerushalmi, "A Scalable
+ * Lock-free Stack Algorithm", SPAA 2004.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes are internal, only the elements count as blocks of the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "estack.h"
+#include "hp.h"
+
+#define CACHE_LINE 64
+
+/* Rounds a thread waits in a slot for a partner */
+#define ELIM_SPINS 128
+
+struct snode {
+    struct snode *next; /* set before the node is published, then fixed */
+    element_t *e;
+};
+
+/* A slot is empty or holds a node a pusher offers. A popper takes the offer
+ * by swapping the slot back to empty, and from then on owns the node; the
+ * pusher learns it was eliminated when it fails to withdraw the offer.
+ */
+struct elim_slot {
+    _Alignas(CACHE_LINE) struct snode *_Atomic offer;
+};
+
+struct estack {
+    _Alignas(CACHE_LINE) struct snode *_Atomic top;
+    _Alignas(CACHE_LINE) atomic_long eliminated;
+    int nslots;
+    struct elim_slot slot[];
+};
+
+/* Slot to try next, xorshift per thread */
+static struct elim_slot *elim_pick(estack_t *s)
+{
+    static __thread uint32_t seed;
+    if (!seed)
+        seed = (uint32_t) (uintptr_t) &seed | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return &s->slot[seed % s->nslots];
+}
+
+estack_t *estack_new(int slots)
+{
+    if (slots < 0 || slots > ESTACK_MAX_SLOTS)
+        return NULL;
+    estack_t *s = aligned_alloc(
+        CACHE_LINE, sizeof(estack_t) + slots * sizeof(struct elim_slot));
+    if (!s)
+        return NULL;
+    atomic_init(&s->top, NULL);
+    atomic_init(&s->eliminated, 0);
+    s->nslots = slots;
+    for (int i = 0; i < slots; i++)
+        atomic_init(&s->slot[i].offer, NULL);
+    return s;
+}
+
+void estack_free(estack_t *s)
+{
+    if (!s)
+        return;
+    for (struct snode *n = atomic_load(&s->top), *next; n; n = next) {
+        next = n->next;
+        q_release_element(n->e);
+        free(n);
+    }
+    free(s);
+}
+
+/* Offer node in a slot for a while. Return true if a pop took it. */
+static bool elim_push(estack_t *s, struct snode *node)
+{
+    struct elim_slot *slot = elim_pick(s);
+    struct snode *empty = NULL;
+    if (!atomic_compare_exchange_strong(&slot->offer, &empty, node))
+        return false;
+    for (int i = 0; i < ELIM_SPINS; i++) {
+        if (atomic_load_explicit(&slot->offer, memory_order_relaxed) != node)
+            break;
+    }
+    struct snode *mine = node;
+    if (atomic_compare_exchange_strong(&slot->offer, &mine, NULL))
+        return false;
+    atomic_fetch_add_explicit(&s->eliminated, 1, memory_order_relaxed);
+    return true;
+}
+
+/* Look for an offer in a slot for a while and take it */
+static struct snode *elim_pop(estack_t *s)
+{
+    struct elim_slot *slot = elim_pick(s);
+    for (int i = 0; i < ELIM_SPINS; i++) {
+        struct snode *node = atomic_load(&slot->offer);
+        if (node && atomic_compare_exchange_strong(&slot->offer, &node, NULL))
+            return node;
+    }
+    return NULL;
+}
+
+bool estack_push(estack_t *s, char *str)
+{
+    if (!(s && str))
+        return false;
+    element_t *e = q_new_element(str);
+    if (!e)
+        return false;
+    if (!estack_push_element(s, e)) {
+        q_release_element(e);
+        return false;
+    }
+    return true;
+}
+
+bool estack_push_element(estack_t *s, element_t *e)
+{
+    if (!(s && e))
+        return false;
+    struct snode *node = malloc(sizeof(struct snode));
+    if (!node)
+        return false;
+    node->e = e;
+
+    /* Push needs no hazard pointer, it never dereferences the top */
+    struct snode *top = atomic_load(&s->top);
+    for (;;) {
+        node->next = top;
+        if (atomic_compare_exchange_weak(&s->top, &top, node))
+            return true;
+        if (s->nslots && elim_push(s, node))
+            return true;
+        top = atomic_load(&s->top);
+    }
+}
+
+element_t *estack_pop(estack_t *s, char *sp, size_t bufsize)
+{
+    if (!s || !hp_ready())
+        return NULL;
+
+    struct snode *top;
+    for (;;) {
+        top = hp_protect(0, (void *_Atomic *) &s->top);
+        if (!top)
+            break;
+        struct snode *next = top->next;
+        if (atomic_compare_exchange_weak(&s->top, &top, next)) {
+            hp_clear();
+            break;
+        }
+        if (s->nslots) {
+            struct snode *node = elim_pop(s);
+            if (node) {
+                hp_clear();
+                top = node;
+                break;
+            }
+        }
+    }
+    if (!top) {
+        hp_clear();
+        return NULL;
+    }
+
+    element_t *e = top->e;
+    hp_retire(top, free);
+    if (sp) {
+        size_t len = strnlen(e->value, bufsize - 1);
+        memcpy(sp, e->value, len);
+        sp[len] = 0;
+    }
+    return e;
+}
+
+long estack_eliminated(estack_t *s)
+{
+    return atomic_load(&s->eliminated);
+}
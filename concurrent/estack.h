@@ -0,0 +1,75 @@
+#ifndef LAB0_ESTACK_H
+#define LAB0_ESTACK_H
+
+/* Lock-free LIFO stack of elements with elimination backoff.
+ *
+ * A Treiber stack: push and pop swing the top pointer by compare-and-swap,
+ * and popped nodes are reclaimed through hazard pointers. A thread whose
+ * compare-and-swap fails tries the elimination array before going back to
+ * the top: a push and a pop meeting in the same slot cancel each other out
+ * without touching the top at all.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+/* Most elimination slots a stack can have */
+#define ESTACK_MAX_SLOTS 64
+
+typedef struct estack estack_t;
+
+/**
+ * estack_new() - Create an empty stack
+ * @slots: slots of the elimination array, 0 for a plain Treiber stack, at
+ *         most ESTACK_MAX_SLOTS
+ *
+ * Return: NULL for allocation failed or too many slots
+ */
+estack_t *estack_new(int slots);
+
+/**
+ * estack_free() - Free the stack and the elements still in it
+ * @s: stack, no effect if NULL
+ *
+ * No other thread may be using the stack any more.
+ */
+void estack_free(estack_t *s);
+
+/**
+ * estack_push() - Push a copy of a string
+ * @s: stack
+ * @str: string to be stored
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool estack_push(estack_t *s, char *str);
+
+/**
+ * estack_push_element() - Push an element made by the caller
+ * @s: stack
+ * @e: element from q_new_element(), owned by the stack on success
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool estack_push_element(estack_t *s, element_t *e);
+
+/**
+ * estack_pop() - Pop the element pushed last
+ * @s: stack
+ * @sp: buffer to copy the removed string to, or NULL
+ * @bufsize: size of @sp
+ *
+ * Same ownership as q_remove_head().
+ *
+ * Return: the element removed, NULL if the stack is NULL or was empty
+ */
+element_t *estack_pop(estack_t *s, char *sp, size_t bufsize);
+
+/**
+ * estack_eliminated() - Count the pushes that met a pop in the array
+ * @s: stack
+ */
+long estack_eliminated(estack_t *s);
+
+#endif /* LAB0_ESTACK_H */
@@ -0,0 +1,283 @@
+/* Hendler, Incze, Shavit and Tzafrir, "Flat Combining and the
+ * Synchronization-Parallelism Tradeoff", SPAA 2010.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The wrapper is internal, only the elements count as blocks of the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "fc.h"
+
+#define CACHE_LINE 64
+
+/* Rounds over the slots a combiner makes before handing the lock back */
+#define FC_PASSES 3
+
+enum fc_op {
+    FC_INSERT_HEAD,
+    FC_INSERT_TAIL,
+    FC_REMOVE_HEAD,
+    FC_REMOVE_TAIL,
+    FC_SIZE,
+    FC_REVERSE,
+    FC_SWAP,
+    FC_SORT,
+    FC_DELETE_DUP,
+};
+
+enum { FC_IDLE, FC_PENDING, FC_DONE };
+
+/* One slot per thread, written by its owner while idle and by the combiner
+ * while pending
+ */
+struct fc_req {
+    _Alignas(CACHE_LINE) atomic_int state;
+    enum fc_op op;
+    char *s;
+    size_t bufsize;
+    union {
+        bool ok;
+        int n;
+        element_t *e;
+    } ret;
+};
+
+struct fc {
+    struct list_head *head;
+    bool combining;
+    pthread_mutex_t lock;
+    long calls, batches; /* under lock */
+    _Alignas(CACHE_LINE) atomic_int active; /* threads inside a call */
+    struct fc_req req[FC_SLOTS];
+};
+
+/* Slot numbers are shared by all wrappers; a thread keeps its number until
+ * it exits
+ */
+static atomic_uint_fast64_t fc_used = 0;
+static pthread_key_t fc_key;
+static pthread_once_t fc_key_once = PTHREAD_ONCE_INIT;
+static __thread int fc_id = -1;
+
+static void fc_release(void *arg)
+{
+    int id = (int) (intptr_t) arg - 1;
+    atomic_fetch_and(&fc_used, ~((uint_fast64_t) 1 << id));
+}
+
+static void fc_make_key(void)
+{
+    pthread_key_create(&fc_key, fc_release);
+}
+
+/* Slot number of the calling thread, -1 if all are taken */
+static int fc_self(void)
+{
+    if (fc_id >= 0)
+        return fc_id;
+    pthread_once(&fc_key_once, fc_make_key);
+    uint_fast64_t used = atomic_load(&fc_used);
+    for (;;) {
+        if (!~used)
+            return -1;
+        int id = __builtin_ctzll(~used);
+        if (atomic_compare_exchange_weak(&fc_used, &used,
+                                         used | ((uint_fast64_t) 1 << id))) {
+            pthread_setspecific(fc_key, (void *) (intptr_t) (id + 1));
+            fc_id = id;
+            return id;
+        }
+    }
+}
+
+fc_t *fc_new(struct list_head *head, bool combining)
+{
+    fc_t *fc = aligned_alloc(CACHE_LINE, sizeof(fc_t));
+    if (!fc)
+        return NULL;
+    fc->head = head;
+    fc->combining = combining;
+    pthread_mutex_init(&fc->lock, NULL);
+    fc->calls = fc->batches = 0;
+    atomic_init(&fc->active, 0);
+    for (int i = 0; i < FC_SLOTS; i++)
+        atomic_init(&fc->req[i].state, FC_IDLE);
+    return fc;
+}
+
+void fc_free(fc_t *fc)
+{
+    if (!fc)
+        return;
+    pthread_mutex_destroy(&fc->lock);
+    free(fc);
+}
+
+static void fc_run(fc_t *fc, struct fc_req *r)
+{
+    struct list_head *head = fc->head;
+    switch (r->op) {
+    case FC_INSERT_HEAD:
+        r->ret.ok = q_insert_head(head, r->s);
+        break;
+    case FC_INSERT_TAIL:
+        r->ret.ok = q_insert_tail(head, r->s);
+        break;
+    case FC_REMOVE_HEAD:
+        r->ret.e = q_remove_head(head, r->s, r->bufsize);
+        break;
+    case FC_REMOVE_TAIL:
+        r->ret.e = q_remove_tail(head, r->s, r->bufsize);
+        break;
+    case FC_SIZE:
+        r->ret.n = q_size(head);
+        break;
+    case FC_REVERSE:
+        q_reverse(head);
+        break;
+    case FC_SWAP:
+        q_swap(head);
+        break;
+    case FC_SORT:
+        q_sort(head);
+        break;
+    case FC_DELETE_DUP: {
+        int before = q_size(head);
+        r->ret.n = q_delete_dup(head) ? before - q_size(head) : -1;
+        break;
+    }
+    }
+    fc->calls++;
+}
+
+/* Run every pending request, with the lock held. Threads inside a call
+ * whose requests are not in yet are about to publish them; the combiner
+ * yields to them between passes, so that when threads outnumber the CPUs
+ * their requests still end up in one batch.
+ */
+static void fc_combine(fc_t *fc)
+{
+    int served = 0;
+    for (int pass = 0; pass < FC_PASSES; pass++) {
+        if (pass && served >= atomic_load(&fc->active))
+            break;
+        if (pass)
+            sched_yield();
+        for (int i = 0; i < FC_SLOTS; i++) {
+            struct fc_req *r = &fc->req[i];
+            if (atomic_load_explicit(&r->state, memory_order_acquire) !=
+                FC_PENDING)
+                continue;
+            fc_run(fc, r);
+            atomic_store_explicit(&r->state, FC_DONE, memory_order_release);
+            served++;
+        }
+    }
+    if (served)
+        fc->batches++;
+}
+
+/* Have the request run, by the combiner or by becoming it */
+static void fc_call(fc_t *fc, struct fc_req *req)
+{
+    int id = fc->combining ? fc_self() : -1;
+    if (id < 0) {
+        pthread_mutex_lock(&fc->lock);
+        fc->batches++;
+        fc_run(fc, req);
+        pthread_mutex_unlock(&fc->lock);
+        return;
+    }
+
+    struct fc_req *r = &fc->req[id];
+    r->op = req->op;
+    r->s = req->s;
+    r->bufsize = req->bufsize;
+    atomic_fetch_add(&fc->active, 1);
+    atomic_store_explicit(&r->state, FC_PENDING, memory_order_release);
+    while (atomic_load_explicit(&r->state, memory_order_acquire) != FC_DONE) {
+        if (!pthread_mutex_trylock(&fc->lock)) {
+            fc_combine(fc);
+            pthread_mutex_unlock(&fc->lock);
+        } else {
+            sched_yield();
+        }
+    }
+    req->ret = r->ret;
+    atomic_store_explicit(&r->state, FC_IDLE, memory_order_relaxed);
+    atomic_fetch_sub(&fc->active, 1);
+}
+
+bool fc_insert_head(fc_t *fc, char *s)
+{
+    struct fc_req req = {.op = FC_INSERT_HEAD, .s = s};
+    fc_call(fc, &req);
+    return req.ret.ok;
+}
+
+bool fc_insert_tail(fc_t *fc, char *s)
+{
+    struct fc_req req = {.op = FC_INSERT_TAIL, .s = s};
+    fc_call(fc, &req);
+    return req.ret.ok;
+}
+
+element_t *fc_remove_head(fc_t *fc, char *sp, size_t bufsize)
+{
+    struct fc_req req = {.op = FC_REMOVE_HEAD, .s = sp, .bufsize = bufsize};
+    fc_call(fc, &req);
+    return req.ret.e;
+}
+
+element_t *fc_remove_tail(fc_t *fc, char *sp, size_t bufsize)
+{
+    struct fc_req req = {.op = FC_REMOVE_TAIL, .s = sp, .bufsize = bufsize};
+    fc_call(fc, &req);
+    return req.ret.e;
+}
+
+int fc_size(fc_t *fc)
+{
+    struct fc_req req = {.op = FC_SIZE};
+    fc_call(fc, &req);
+    return req.ret.n;
+}
+
+void fc_reverse(fc_t *fc)
+{
+    struct fc_req req = {.op = FC_REVERSE};
+    fc_call(fc, &req);
+}
+
+void fc_swap(fc_t *fc)
+{
+    struct fc_req req = {.op = FC_SWAP};
+    fc_call(fc, &req);
+}
+
+void fc_sort(fc_t *fc)
+{
+    struct fc_req req = {.op = FC_SORT};
+    fc_call(fc, &req);
+}
+
+int fc_delete_dup(fc_t *fc)
+{
+    struct fc_req req = {.op = FC_DELETE_DUP};
+    fc_call(fc, &req);
+    return req.ret.n;
+}
+
+void fc_stats(fc_t *fc, long *calls, long *batches)
+{
+    pthread_mutex_lock(&fc->lock);
+    *calls = fc->calls;
+    *batches = fc->batches;
+    pthread_mutex_unlock(&fc->lock);
+}
@@ -0,0 +1,66 @@
+#ifndef LAB0_FC_H
+#define LAB0_FC_H
+
+/* Flat combining around a queue of queue.c.
+ *
+ * A thread publishes each call in a request slot of its own, then either
+ * waits for the answer or, if it gets the combiner lock, runs the pending
+ * requests of all threads against the queue in one batch. The queue is
+ * touched by one thread at a time and the lock changes hands once per
+ * batch instead of once per call.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+/* Threads that can publish requests at a time, others take the lock */
+#define FC_SLOTS 64
+
+typedef struct fc fc_t;
+
+/**
+ * fc_new() - Wrap a queue for sharing among threads
+ * @head: queue created by q_new() or one of its variants
+ * @combining: false to take the lock around each call instead, for
+ *             comparison
+ *
+ * The queue stays owned by the caller and must outlive the wrapper.
+ *
+ * Return: NULL for allocation failed
+ */
+fc_t *fc_new(struct list_head *head, bool combining);
+
+/**
+ * fc_free() - Free the wrapper, not the queue
+ * @fc: wrapper, no effect if NULL
+ */
+void fc_free(fc_t *fc);
+
+/* Thread-safe versions of the q_* functions of the same names */
+bool fc_insert_head(fc_t *fc, char *s);
+bool fc_insert_tail(fc_t *fc, char *s);
+element_t *fc_remove_head(fc_t *fc, char *sp, size_t bufsize);
+element_t *fc_remove_tail(fc_t *fc, char *sp, size_t bufsize);
+int fc_size(fc_t *fc);
+void fc_reverse(fc_t *fc);
+void fc_swap(fc_t *fc);
+void fc_sort(fc_t *fc);
+
+/**
+ * fc_delete_dup() - Thread-safe q_delete_dup()
+ * @fc: wrapper
+ *
+ * Return: number of elements deleted, -1 if q_delete_dup() failed
+ */
+int fc_delete_dup(fc_t *fc);
+
+/**
+ * fc_stats() - Tell how well requests were combined
+ * @fc: wrapper
+ * @calls: where to store the number of calls run so far
+ * @batches: where to store the number of times the lock was taken for them
+ */
+void fc_stats(fc_t *fc, long *calls, long *batches);
+
+#endif /* LAB0_FC_H */
@@ -0,0 +1,253 @@
+/* Work stealing after Blumofe and Leiserson, "Scheduling Multithreaded
+ * Computations by Work Stealing", JACM 1999, on the Chase-Lev deques of
+ * deque.c.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The pool is internal, not a block handed to the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "deque.h"
+#include "forkjoin.h"
+
+/* Tasks a thread can have spawned and not yet joined, more run inline */
+#define FJ_DEQUE_CAP 4096
+
+/* Deque 0 belongs to the thread inside fj_run(), the others to the pool
+ * threads. Tasks queued counts tasks sitting in deques; a pool thread only
+ * sleeps when it is zero. A deferred signal sets cancel until the
+ * computation is over.
+ */
+static struct {
+    int nthreads;
+    pthread_t *tid;
+    deque_t **dq;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    atomic_int queued, sleepers;
+    atomic_bool stop, cancel;
+    atomic_int deferred;
+} fj = {
+    .nthreads = 1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+/* Computations of different threads take turns on deque 0 */
+static pthread_mutex_t fj_run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Deque of the calling thread, -1 outside the pool */
+static __thread int fj_self = -1;
+
+/* Set while the calling thread is in fj_run(), read by signal handlers */
+static __thread volatile sig_atomic_t fj_entered;
+
+static void fj_exec(struct fj_task *t)
+{
+    t->fn(t->arg);
+    atomic_fetch_sub_explicit(&t->join->pending, 1, memory_order_release);
+}
+
+/* Take a task from the own deque, else steal one from another */
+static struct fj_task *fj_find(int self)
+{
+    struct fj_task *t = deque_pop(fj.dq[self]);
+    for (int k = 1; !t && k < fj.nthreads; k++)
+        t = deque_steal(fj.dq[(self + k) % fj.nthreads]);
+    if (t)
+        atomic_fetch_sub(&fj.queued, 1);
+    return t;
+}
+
+static void *fj_worker(void *arg)
+{
+    int self = (int) (intptr_t) arg;
+    fj_self = self;
+    while (!atomic_load(&fj.stop)) {
+        struct fj_task *t = fj_find(self);
+        if (t) {
+            fj_exec(t);
+            continue;
+        }
+        /* Announce the sleep before the last look, fj_spawn() checks the
+         * sleepers after queueing
+         */
+        atomic_fetch_add(&fj.sleepers, 1);
+        pthread_mutex_lock(&fj.lock);
+        while (!atomic_load(&fj.queued) && !atomic_load(&fj.stop))
+            pthread_cond_wait(&fj.wake, &fj.lock);
+        pthread_mutex_unlock(&fj.lock);
+        atomic_fetch_sub(&fj.sleepers, 1);
+    }
+    return NULL;
+}
+
+/* Stop and join the first started threads, free the pool */
+static void fj_shutdown(int started)
+{
+    pthread_mutex_lock(&fj.lock);
+    atomic_store(&fj.stop, true);
+    pthread_cond_broadcast(&fj.wake);
+    pthread_mutex_unlock(&fj.lock);
+    for (int i = 1; i < started; i++)
+        pthread_join(fj.tid[i], NULL);
+    for (int i = 0; fj.dq && i < fj.nthreads; i++)
+        deque_free(fj.dq[i]);
+    free(fj.dq);
+    free(fj.tid);
+    fj.dq = NULL;
+    fj.tid = NULL;
+    fj.nthreads = 1;
+    atomic_store(&fj.stop, false);
+}
+
+bool fj_set_workers(int n)
+{
+    if (n < 1)
+        n = 1;
+    if (fj.dq && n == fj.nthreads)
+        return true;
+    fj_shutdown(fj.nthreads);
+
+    fj.nthreads = n;
+    fj.tid = malloc(n * sizeof(pthread_t));
+    fj.dq = calloc(n, sizeof(deque_t *));
+    bool ok = fj.tid && fj.dq;
+    for (int i = 0; ok && i < n; i++)
+        ok = (fj.dq[i] = deque_new(FJ_DEQUE_CAP)) != NULL;
+    if (!ok) {
+        fj_shutdown(1);
+        return false;
+    }
+
+    /* Signals for the thread running the commands never go to the pool */
+    sigset_t old;
+    block_async_signals(&old);
+    int started = 1;
+    while (started < n && !pthread_create(&fj.tid[started], NULL, fj_worker,
+                                          (void *) (intptr_t) started))
+        started++;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (started < n) {
+        fj_shutdown(started);
+        return false;
+    }
+    return true;
+}
+
+int fj_workers(void)
+{
+    return fj.dq ? fj.nthreads : 1;
+}
+
+void fj_run(void (*fn)(void *arg), void *arg)
+{
+    if (fj_self >= 0) {
+        fn(arg);
+        return;
+    }
+
+    atomic_store(&fj.deferred, 0);
+    fj_entered = 1;
+    pthread_mutex_lock(&fj_run_lock);
+    fj_self = 0;
+    fn(arg);
+    fj_self = -1;
+    atomic_store(&fj.cancel, false);
+    pthread_mutex_unlock(&fj_run_lock);
+    fj_entered = 0;
+
+    int sig = atomic_exchange(&fj.deferred, 0);
+    if (sig)
+        raise(sig);
+}
+
+bool fj_cancelled(void)
+{
+    return atomic_load_explicit(&fj.cancel, memory_order_relaxed);
+}
+
+bool fj_defer_signal(int sig)
+{
+    if (!fj_entered)
+        return false;
+    atomic_store(&fj.cancel, true);
+    atomic_store(&fj.deferred, sig);
+    return true;
+}
+
+void fj_spawn(struct fj_join *j,
+              struct fj_task *t,
+              void (*fn)(void *arg),
+              void *arg)
+{
+    t->fn = fn;
+    t->arg = arg;
+    t->join = j;
+    atomic_fetch_add_explicit(&j->pending, 1, memory_order_relaxed);
+    if (!fj.dq || fj_self < 0 || !deque_push(fj.dq[fj_self], t)) {
+        fj_exec(t);
+        return;
+    }
+    atomic_fetch_add(&fj.queued, 1);
+    if (atomic_load(&fj.sleepers)) {
+        pthread_mutex_lock(&fj.lock);
+        pthread_cond_signal(&fj.wake);
+        pthread_mutex_unlock(&fj.lock);
+    }
+}
+
+void fj_join(struct fj_join *j)
+{
+    while (atomic_load_explicit(&j->pending, memory_order_acquire)) {
+        struct fj_task *t = fj.dq && fj_self >= 0 ? fj_find(fj_self) : NULL;
+        if (t)
+            fj_exec(t);
+        else
+            sched_yield();
+    }
+}
+
+struct fj_for {
+    size_t lo, hi, grain;
+    void (*body)(size_t lo, size_t hi, void *arg);
+    void *arg;
+};
+
+/* Split the range in halves until it is down to the grain */
+static void fj_for_run(void *arg)
+{
+    struct fj_for *f = arg;
+    if (fj_cancelled())
+        return;
+    if (f->hi - f->lo <= f->grain) {
+        f->body(f->lo, f->hi, f->arg);
+        return;
+    }
+    size_t mid = f->lo + (f->hi - f->lo) / 2;
+    struct fj_for left = *f, right = *f;
+    left.hi = mid;
+    right.lo = mid;
+    struct fj_join j = FJ_JOIN_INIT;
+    struct fj_task t;
+    fj_spawn(&j, &t, fj_for_run, &left);
+    fj_for_run(&right);
+    fj_join(&j);
+}
+
+void fj_parallel_for(size_t n,
+                     size_t grain,
+                     void (*body)(size_t lo, size_t hi, void *arg),
+                     void *arg)
+{
+    if (!n)
+        return;
+    struct fj_for f = {0, n, grain ? grain : 1, body, arg};
+    fj_run(fj_for_run, &f);
+}
@@ -0,0 +1,123 @@
+#ifndef LAB0_FORKJOIN_H
+#define LAB0_FORKJOIN_H
+
+/* Fork-join thread pool with work stealing.
+ *
+ * One pool serves the whole program. Each pool thread, and the thread that
+ * enters the pool through fj_run(), has a work-stealing deque: tasks it
+ * spawns go to the bottom of its own deque, idle threads steal from the top
+ * of the others. A thread waiting in fj_join() runs tasks meanwhile instead
+ * of blocking. Pool threads with nothing to steal sleep on a condition
+ * variable, so an idle pool uses no CPU.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Join counter of the tasks spawned against it */
+struct fj_join {
+    atomic_int pending;
+};
+
+#define FJ_JOIN_INIT {0}
+
+/* A spawned task, owned by the spawner until the join returns */
+struct fj_task {
+    void (*fn)(void *arg);
+    void *arg;
+    struct fj_join *join;
+};
+
+/**
+ * fj_set_workers() - Resize the pool
+ * @n: threads to run tasks, the one calling fj_run() included
+ *
+ * Must not be called while a computation is in the pool.
+ *
+ * Return: false if the pool could not be set up; tasks then all run on the
+ * thread calling fj_run()
+ */
+bool fj_set_workers(int n);
+
+/**
+ * fj_workers() - Tell how many threads run tasks
+ *
+ * Return: the size of the pool, at least 1
+ */
+int fj_workers(void);
+
+/**
+ * fj_run() - Run a fork-join computation
+ * @fn: root task, may spawn and join further tasks
+ * @arg: argument of @fn
+ *
+ * Runs @fn on the calling thread, which takes part in running the tasks
+ * until @fn returns. Computations of different threads take turns; called
+ * from within a task, @fn simply runs as part of the computation.
+ */
+void fj_run(void (*fn)(void *arg), void *arg);
+
+/**
+ * fj_defer_signal() - Hold a signal off until the computation is over
+ * @sig: signal being handled
+ *
+ * For signal handlers that longjmp, which must not leave tasks behind that
+ * point into unwound stack frames. Called on the thread inside fj_run(), it
+ * makes fj_cancelled() true for the rest of the computation, and @sig is
+ * raised again once fj_run() is about to return. Pool threads never get the
+ * signals meant for the thread running the commands.
+ *
+ * Return: true if @sig was deferred, false if the calling thread is not in
+ * fj_run() and the handler can go on
+ */
+bool fj_defer_signal(int sig);
+
+/**
+ * fj_cancelled() - Tell whether the computation is to stop early
+ *
+ * Tasks check it before starting their work and skip what the computation
+ * can do without; the loops of fj_parallel_for() skip their bodies.
+ *
+ * Return: true once a signal has been deferred by fj_defer_signal()
+ */
+bool fj_cancelled(void);
+
+/**
+ * fj_spawn() - Make a task available to the pool
+ * @j: join counter to count the task against
+ * @t: task storage, must stay valid until fj_join(@j) returns
+ * @fn: function to run
+ * @arg: argument of @fn
+ *
+ * Only valid inside fj_run(). The task may run on any thread of the pool,
+ * or on the calling thread if no other takes it.
+ */
+void fj_spawn(struct fj_join *j,
+              struct fj_task *t,
+              void (*fn)(void *arg),
+              void *arg);
+
+/**
+ * fj_join() - Wait for the tasks spawned against a join counter
+ * @j: join counter
+ *
+ * Runs other tasks while waiting.
+ */
+void fj_join(struct fj_join *j);
+
+/**
+ * fj_parallel_for() - Run a loop body over ranges of an index space
+ * @n: size of the index space
+ * @grain: fewest indices worth a task of their own
+ * @body: called with disjoint ranges [lo, hi) covering [0, @n)
+ * @arg: argument of @body
+ *
+ * Enters the pool through fj_run() unless called from a task already.
+ */
+void fj_parallel_for(size_t n,
+                     size_t grain,
+                     void (*body)(size_t lo, size_t hi, void *arg),
+                     void *arg);
+
+#endif /* LAB0_FORKJOIN_H */
@@ -0,0 +1,179 @@
+/* Hazard pointers, after Michael, "Hazard Pointers: Safe Memory Reclamation
+ * for Lock-Free Objects", IEEE TPDS 2004.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Records and retired lists are internal, not blocks handed to the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "hp.h"
+
+/* Retired nodes a thread collects before scanning the hazard slots, on top
+ * of the number of slots of all threads
+ */
+#define HP_RETIRE_SLACK 64
+
+struct hp_retired {
+    void *p;
+    void (*free_fn)(void *);
+};
+
+struct hp_rec {
+    void *_Atomic hp[HP_SLOTS];
+    struct hp_rec *next; /* records are never freed, only reused */
+    atomic_bool active;
+    struct hp_retired *retired;
+    size_t nretired, cap;
+};
+
+static struct hp_rec *_Atomic hp_records = NULL;
+static atomic_int hp_nrecords = 0;
+
+static pthread_key_t hp_key;
+static pthread_once_t hp_key_once = PTHREAD_ONCE_INIT;
+static __thread struct hp_rec *hp_self = NULL;
+
+/* Called when a thread with a record exits */
+static void hp_release(void *arg)
+{
+    struct hp_rec *r = arg;
+    for (int i = 0; i < HP_SLOTS; i++)
+        atomic_store(&r->hp[i], NULL);
+    atomic_store(&r->active, false);
+}
+
+static void hp_make_key(void)
+{
+    pthread_key_create(&hp_key, hp_release);
+}
+
+bool hp_ready(void)
+{
+    if (hp_self)
+        return true;
+    pthread_once(&hp_key_once, hp_make_key);
+
+    struct hp_rec *r;
+    for (r = atomic_load(&hp_records); r; r = r->next) {
+        bool idle = false;
+        if (atomic_compare_exchange_strong(&r->active, &idle, true))
+            break;
+    }
+    if (!r) {
+        r = calloc(1, sizeof(struct hp_rec));
+        if (!r)
+            return false;
+        atomic_store(&r->active, true);
+        r->next = atomic_load(&hp_records);
+        while (!atomic_compare_exchange_weak(&hp_records, &r->next, r))
+            ;
+        atomic_fetch_add(&hp_nrecords, 1);
+    }
+    pthread_setspecific(hp_key, r);
+    hp_self = r;
+    return true;
+}
+
+void *hp_protect(int slot, void *_Atomic *src)
+{
+    if (!hp_ready())
+        return NULL;
+    void *p = atomic_load(src);
+    for (;;) {
+        /* Sequentially consistent store then load: the slot is visible to
+         * scanners before src is checked again
+         */
+        atomic_store(&hp_self->hp[slot], p);
+        void *again = atomic_load(src);
+        if (again == p)
+            return p;
+        p = again;
+    }
+}
+
+void hp_clear(void)
+{
+    if (!hp_self)
+        return;
+    for (int i = 0; i < HP_SLOTS; i++)
+        atomic_store_explicit(&hp_self->hp[i], NULL, memory_order_release);
+}
+
+static int cmp_ptr(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t) *(void *const *) a;
+    uintptr_t y = (uintptr_t) *(void *const *) b;
+    return (x > y) - (x < y);
+}
+
+/* Free the nodes retired in r that no hazard slot holds */
+static void hp_scan(struct hp_rec *r)
+{
+    /* Records pushed after this snapshot belong to threads that started
+     * after the nodes of r were unlinked, they cannot hold any of them
+     */
+    struct hp_rec *first = atomic_load(&hp_records);
+    size_t n = 0, cap = 0;
+    for (struct hp_rec *h = first; h; h = h->next)
+        cap += HP_SLOTS;
+    void **hazards = malloc(cap * sizeof(void *));
+    if (!hazards)
+        return;
+    for (struct hp_rec *h = first; h; h = h->next) {
+        for (int i = 0; i < HP_SLOTS; i++) {
+            void *p = atomic_load(&h->hp[i]);
+            if (p)
+                hazards[n++] = p;
+        }
+    }
+    qsort(hazards, n, sizeof(void *), cmp_ptr);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < r->nretired; i++) {
+        struct hp_retired *x = &r->retired[i];
+        if (bsearch(&x->p, hazards, n, sizeof(void *), cmp_ptr))
+            r->retired[kept++] = *x;
+        else
+            x->free_fn(x->p);
+    }
+    r->nretired = kept;
+    free(hazards);
+}
+
+void hp_retire(void *p, void (*free_fn)(void *))
+{
+    if (!hp_ready()) {
+        /* Nowhere to keep it, leaking beats freeing it under a reader */
+        return;
+    }
+    struct hp_rec *r = hp_self;
+    if (r->nretired == r->cap) {
+        size_t cap = r->cap ? r->cap * 2 : HP_RETIRE_SLACK;
+        struct hp_retired *grown = realloc(r->retired, cap * sizeof(*grown));
+        if (!grown) {
+            hp_scan(r);
+            if (r->nretired == r->cap)
+                return;
+        } else {
+            r->retired = grown;
+            r->cap = cap;
+        }
+    }
+    r->retired[r->nretired].p = p;
+    r->retired[r->nretired].free_fn = free_fn;
+    r->nretired++;
+
+    size_t threshold = (size_t) atomic_load(&hp_nrecords) * HP_SLOTS;
+    if (r->nretired >= threshold + HP_RETIRE_SLACK)
+        hp_scan(r);
+}
+
+void hp_drain(void)
+{
+    for (struct hp_rec *r = atomic_load(&hp_records); r; r = r->next)
+        hp_scan(r);
+}
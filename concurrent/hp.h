@@ -0,0 +1,60 @@
+#ifndef LAB0_HP_H
+#define LAB0_HP_H
+
+/* Hazard pointers: safe memory reclamation for lock-free structures.
+ *
+ * A thread publishes the nodes it is about to dereference in its hazard
+ * slots. Unlinked nodes are retired instead of freed, and a retired node is
+ * only freed once no slot of any thread holds it. Each thread gets its
+ * record on first use; the record goes back to a shared list, with the
+ * nodes it still has retired, when the thread exits.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/* Hazard slots per thread */
+#define HP_SLOTS 2
+
+/**
+ * hp_protect() - Load a shared pointer and publish it in a hazard slot
+ * @slot: hazard slot of the calling thread to use
+ * @src: shared pointer to load
+ *
+ * The pointer is loaded again after publishing it, until both loads agree.
+ * From then on the node it points to is not freed before the slot is
+ * cleared or reused, even if it is unlinked and retired meanwhile.
+ *
+ * Return: the pointer loaded, NULL if the calling thread could not get its
+ * record; hp_protect() then publishes nothing.
+ */
+void *hp_protect(int slot, void *_Atomic *src);
+
+/**
+ * hp_clear() - Clear all hazard slots of the calling thread
+ */
+void hp_clear(void);
+
+/**
+ * hp_retire() - Free a node once no thread protects it any more
+ * @p: node unlinked from every shared structure
+ * @free_fn: function freeing @p
+ */
+void hp_retire(void *p, void (*free_fn)(void *));
+
+/**
+ * hp_ready() - Make sure the calling thread has its record
+ *
+ * Return: false if it could not be allocated
+ */
+bool hp_ready(void);
+
+/**
+ * hp_drain() - Free every retired node that is not protected
+ *
+ * Meant for quiescent points, e.g. after joining all worker threads, so that
+ * nothing retired by threads that went away is kept longer than needed.
+ */
+void hp_drain(void);
+
+#endif /* LAB0_HP_H */
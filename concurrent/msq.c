@@ -0,0 +1,142 @@
+/* Michael and Scott, "Simple, Fast, and Practical Non-Blocking and Blocking
+ * Concurrent Queue Algorithms", PODC 1996, with hazard pointers.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes are internal, only the elements count as blocks of the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "hp.h"
+#include "msq.h"
+
+#define CACHE_LINE 64
+
+struct msq_node {
+    struct msq_node *_Atomic next;
+    element_t *e;
+};
+
+/* Head and tail on cache lines of their own, consumers and producers each
+ * write only one of them
+ */
+struct msq {
+    _Alignas(CACHE_LINE) struct msq_node *_Atomic head;
+    _Alignas(CACHE_LINE) struct msq_node *_Atomic tail;
+};
+
+msq_t *msq_new(void)
+{
+    msq_t *q = aligned_alloc(CACHE_LINE, sizeof(msq_t));
+    struct msq_node *dummy = malloc(sizeof(struct msq_node));
+    if (!q || !dummy || !hp_ready()) {
+        free(q);
+        free(dummy);
+        return NULL;
+    }
+    atomic_init(&dummy->next, NULL);
+    dummy->e = NULL;
+    atomic_init(&q->head, dummy);
+    atomic_init(&q->tail, dummy);
+    return q;
+}
+
+void msq_free(msq_t *q)
+{
+    if (!q)
+        return;
+    struct msq_node *n = atomic_load(&q->head);
+    struct msq_node *next = atomic_load(&n->next);
+    free(n);
+    for (n = next; n; n = next) {
+        next = atomic_load(&n->next);
+        q_release_element(n->e);
+        free(n);
+    }
+    free(q);
+}
+
+bool msq_insert_tail(msq_t *q, char *s)
+{
+    if (!(q && s))
+        return false;
+    element_t *e = q_new_element(s);
+    if (!e)
+        return false;
+    if (!msq_insert_element(q, e)) {
+        q_release_element(e);
+        return false;
+    }
+    return true;
+}
+
+bool msq_insert_element(msq_t *q, element_t *e)
+{
+    if (!(q && e))
+        return false;
+    struct msq_node *node = malloc(sizeof(struct msq_node));
+    if (!node || !hp_ready()) {
+        free(node);
+        return false;
+    }
+    atomic_init(&node->next, NULL);
+    node->e = e;
+
+    for (;;) {
+        struct msq_node *tail = hp_protect(0, (void *_Atomic *) &q->tail);
+        struct msq_node *next = atomic_load(&tail->next);
+        if (tail != atomic_load(&q->tail))
+            continue;
+        if (next) {
+            /* Tail is lagging behind, help swinging it */
+            atomic_compare_exchange_weak(&q->tail, &tail, next);
+            continue;
+        }
+        if (atomic_compare_exchange_weak(&tail->next, &next, node)) {
+            atomic_compare_exchange_strong(&q->tail, &tail, node);
+            break;
+        }
+    }
+    hp_clear();
+    return true;
+}
+
+element_t *msq_remove_head(msq_t *q, char *sp, size_t bufsize)
+{
+    if (!q || !hp_ready())
+        return NULL;
+
+    struct msq_node *head;
+    element_t *e;
+    for (;;) {
+        head = hp_protect(0, (void *_Atomic *) &q->head);
+        struct msq_node *tail = atomic_load(&q->tail);
+        struct msq_node *next = hp_protect(1, (void *_Atomic *) &head->next);
+        if (head != atomic_load(&q->head))
+            continue;
+        if (!next) {
+            hp_clear();
+            return NULL;
+        }
+        if (head == tail) {
+            atomic_compare_exchange_weak(&q->tail, &tail, next);
+            continue;
+        }
+        /* next becomes the dummy, its element goes to the caller */
+        e = next->e;
+        if (atomic_compare_exchange_weak(&q->head, &head, next))
+            break;
+    }
+    hp_clear();
+    hp_retire(head, free);
+
+    if (sp) {
+        size_t len = strnlen(e->value, bufsize - 1);
+        memcpy(sp, e->value, len);
+        sp[len] = 0;
+    }
+    return e;
+}
@@ -0,0 +1,66 @@
+#ifndef LAB0_MSQ_H
+#define LAB0_MSQ_H
+
+/* Lock-free multi-producer multi-consumer FIFO queue of elements.
+ *
+ * Michael and Scott's non-blocking queue: a singly-linked list with a dummy
+ * node in front, tail and head swung forward by compare-and-swap. Unlinked
+ * nodes are reclaimed through hazard pointers, so any number of threads may
+ * insert and remove at the same time.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+typedef struct msq msq_t;
+
+/**
+ * msq_new() - Create an empty queue
+ *
+ * Return: NULL for allocation failed
+ */
+msq_t *msq_new(void);
+
+/**
+ * msq_free() - Free the queue and the elements still in it
+ * @q: queue, no effect if NULL
+ *
+ * No other thread may be using the queue any more.
+ */
+void msq_free(msq_t *q);
+
+/**
+ * msq_insert_tail() - Insert an element at the tail
+ * @q: queue
+ * @s: string to be stored
+ *
+ * Like q_insert_tail(), the element holds its own copy of @s.
+ *
+ * Return: true for success, false for allocation failed or queue is NULL
+ */
+bool msq_insert_tail(msq_t *q, char *s);
+
+/**
+ * msq_insert_element() - Insert an element made by the caller at the tail
+ * @q: queue
+ * @e: element from q_new_element(), owned by the queue on success
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool msq_insert_element(msq_t *q, element_t *e);
+
+/**
+ * msq_remove_head() - Remove the element at the head
+ * @q: queue
+ * @sp: buffer to copy the removed string to, or NULL
+ * @bufsize: size of @sp
+ *
+ * Like q_remove_head(), the element is handed over to the caller, who
+ * releases it with q_release_element().
+ *
+ * Return: the element removed, NULL if the queue is NULL or was empty
+ */
+element_t *msq_remove_head(msq_t *q, char *sp, size_t bufsize);
+
+#endif /* LAB0_MSQ_H */
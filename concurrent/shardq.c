@@ -0,0 +1,170 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Shards and batches are internal, only the elements count as blocks */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "deque.h"
+#include "shardq.h"
+
+#define CACHE_LINE 64
+
+/* Batches a shard can expose at a time, further elements stay local */
+#define SHARD_DEQUE_CAP 1024
+
+struct batch {
+    struct list_head list;
+    int n;
+};
+
+struct shard {
+    _Alignas(CACHE_LINE) struct list_head local; /* owner only */
+    int n;
+    deque_t *dq;
+    atomic_long steals;
+};
+
+struct shardq {
+    int nshards;
+    struct shard shard[];
+};
+
+shardq_t *shardq_new(int shards)
+{
+    if (shards <= 0)
+        return NULL;
+    shardq_t *q = aligned_alloc(
+        CACHE_LINE, sizeof(shardq_t) + shards * sizeof(struct shard));
+    if (!q)
+        return NULL;
+    q->nshards = shards;
+    for (int i = 0; i < shards; i++) {
+        struct shard *sh = &q->shard[i];
+        INIT_LIST_HEAD(&sh->local);
+        sh->n = 0;
+        atomic_init(&sh->steals, 0);
+        sh->dq = deque_new(SHARD_DEQUE_CAP);
+        if (!sh->dq) {
+            q->nshards = i;
+            shardq_free(q);
+            return NULL;
+        }
+    }
+    return q;
+}
+
+static void release_list(struct list_head *head)
+{
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, head, list)
+        q_release_element(e);
+}
+
+void shardq_free(shardq_t *q)
+{
+    if (!q)
+        return;
+    for (int i = 0; i < q->nshards; i++) {
+        struct shard *sh = &q->shard[i];
+        release_list(&sh->local);
+        for (struct batch *b; (b = deque_pop(sh->dq));) {
+            release_list(&b->list);
+            free(b);
+        }
+        deque_free(sh->dq);
+    }
+    free(q);
+}
+
+/* Move the SHARD_BATCH oldest elements of sh to its deque */
+static void expose(struct shard *sh)
+{
+    struct batch *b = malloc(sizeof(struct batch));
+    if (!b)
+        return;
+    struct list_head *last = sh->local.next;
+    for (int i = 1; i < SHARD_BATCH; i++)
+        last = last->next;
+    INIT_LIST_HEAD(&b->list);
+    list_cut_position(&b->list, &sh->local, last);
+    b->n = SHARD_BATCH;
+
+    if (!deque_push(sh->dq, b)) {
+        /* Deque full, keep the elements */
+        list_splice(&b->list, &sh->local);
+        free(b);
+        return;
+    }
+    sh->n -= SHARD_BATCH;
+}
+
+bool shardq_insert(shardq_t *q, int shard, char *s)
+{
+    if (!(q && s))
+        return false;
+    element_t *e = q_new_element(s);
+    if (!e)
+        return false;
+    shardq_insert_element(q, shard, e);
+    return true;
+}
+
+bool shardq_insert_element(shardq_t *q, int shard, element_t *e)
+{
+    if (!(q && e))
+        return false;
+    struct shard *sh = &q->shard[shard];
+    list_add_tail(&e->list, &sh->local);
+    if (++sh->n >= 2 * SHARD_BATCH)
+        expose(sh);
+    return true;
+}
+
+/* Refill the empty local list of shard i with a batch */
+static bool refill(shardq_t *q, int i)
+{
+    struct shard *sh = &q->shard[i];
+    /* Own batches oldest first too, unless a thief got in the way */
+    struct batch *b = deque_steal(sh->dq);
+    if (!b)
+        b = deque_pop(sh->dq);
+    for (int k = 1; !b && k < q->nshards; k++) {
+        b = deque_steal(q->shard[(i + k) % q->nshards].dq);
+        if (b)
+            atomic_fetch_add_explicit(&sh->steals, 1, memory_order_relaxed);
+    }
+    if (!b)
+        return false;
+    list_splice(&b->list, &sh->local);
+    sh->n = b->n;
+    free(b);
+    return true;
+}
+
+element_t *shardq_remove(shardq_t *q, int shard, char *sp, size_t bufsize)
+{
+    if (!q)
+        return NULL;
+    struct shard *sh = &q->shard[shard];
+    if (list_empty(&sh->local) && !refill(q, shard))
+        return NULL;
+    element_t *e = list_first_entry(&sh->local, element_t, list);
+    list_del(&e->list);
+    sh->n--;
+    if (sp) {
+        size_t len = strnlen(e->value, bufsize - 1);
+        memcpy(sp, e->value, len);
+        sp[len] = 0;
+    }
+    return e;
+}
+
+long shardq_steals(shardq_t *q)
+{
+    long steals = 0;
+    for (int i = 0; i < q->nshards; i++)
+        steals += atomic_load(&q->shard[i].steals);
+    return steals;
+}
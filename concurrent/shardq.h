@@ -0,0 +1,86 @@
+#ifndef LAB0_SHARDQ_H
+#define LAB0_SHARDQ_H
+
+/* Sharded queue of elements with work stealing, relaxed FIFO.
+ *
+ * Each worker thread owns one shard: a list.h queue it inserts into and
+ * removes from without any atomic operation. When a shard grows long, its
+ * owner moves a batch of the oldest elements to the shard's work-stealing
+ * deque. A worker whose shard runs dry takes back its own batches first,
+ * then steals the oldest batches of the other shards.
+ *
+ * Order is relaxed within a shard too: batches are exposed and taken back
+ * oldest first, and each keeps its elements in order, but the owner removes
+ * the newer elements still local before it returns to its exposed batches.
+ * Removing returns NULL when the shard is empty and no batch is there to
+ * steal, even if other shards hold a few elements below the batch
+ * threshold.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+/* Elements moved at a time, a shard exposes a batch once it holds twice as
+ * many
+ */
+#define SHARD_BATCH 32
+
+typedef struct shardq shardq_t;
+
+/**
+ * shardq_new() - Create an empty queue
+ * @shards: number of shards, one per worker thread
+ *
+ * Return: NULL for allocation failed or no shards
+ */
+shardq_t *shardq_new(int shards);
+
+/**
+ * shardq_free() - Free the queue and the elements still in it
+ * @q: queue, no effect if NULL
+ *
+ * No thread may be using the queue any more.
+ */
+void shardq_free(shardq_t *q);
+
+/**
+ * shardq_insert() - Insert a copy of a string into a shard
+ * @q: queue
+ * @shard: shard owned by the calling thread
+ * @s: string to be stored
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool shardq_insert(shardq_t *q, int shard, char *s);
+
+/**
+ * shardq_insert_element() - Insert an element made by the caller
+ * @q: queue
+ * @shard: shard owned by the calling thread
+ * @e: element from q_new_element(), owned by the queue on success
+ *
+ * Return: true for success, false for NULL arguments
+ */
+bool shardq_insert_element(shardq_t *q, int shard, element_t *e);
+
+/**
+ * shardq_remove() - Remove an element, stealing if the shard is empty
+ * @q: queue
+ * @shard: shard owned by the calling thread
+ * @sp: buffer to copy the removed string to, or NULL
+ * @bufsize: size of @sp
+ *
+ * Same ownership as q_remove_head().
+ *
+ * Return: the element removed, NULL if nothing could be found
+ */
+element_t *shardq_remove(shardq_t *q, int shard, char *sp, size_t bufsize);
+
+/**
+ * shardq_steals() - Count the batches taken from other shards
+ * @q: queue
+ */
+long shardq_steals(shardq_t *q);
+
+#endif /* LAB0_SHARDQ_H */
@@ -0,0 +1,129 @@
+/* Lamport's single-producer single-consumer ring, with the indices cached on
+ * each side as in FastForward / MCRingBuffer.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The ring is internal, only the elements count as blocks of the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "spsc.h"
+
+#define CACHE_LINE 64
+
+/* Indices run freely and are masked on access. Each side writes only the
+ * cache line it owns; the other side's index is read only when the cached
+ * copy runs out.
+ */
+struct spsc {
+    struct {
+        _Alignas(CACHE_LINE) atomic_size_t tail;
+        size_t head_cache;
+    } prod;
+    struct {
+        _Alignas(CACHE_LINE) atomic_size_t head;
+        size_t tail_cache;
+    } cons;
+    _Alignas(CACHE_LINE) size_t mask;
+    element_t **slot;
+};
+
+spsc_t *spsc_new(size_t cap)
+{
+    if (!cap || cap > ((size_t) -1 >> 2))
+        return NULL;
+    size_t n = 1;
+    while (n < cap)
+        n <<= 1;
+    spsc_t *r = aligned_alloc(CACHE_LINE, sizeof(spsc_t));
+    element_t **slot = malloc(n * sizeof(element_t *));
+    if (!r || !slot) {
+        free(r);
+        free(slot);
+        return NULL;
+    }
+    atomic_init(&r->prod.tail, 0);
+    r->prod.head_cache = 0;
+    atomic_init(&r->cons.head, 0);
+    r->cons.tail_cache = 0;
+    r->mask = n - 1;
+    r->slot = slot;
+    return r;
+}
+
+void spsc_free(spsc_t *r)
+{
+    if (!r)
+        return;
+    size_t tail = atomic_load(&r->prod.tail);
+    for (size_t i = atomic_load(&r->cons.head); i != tail; i++)
+        q_release_element(r->slot[i & r->mask]);
+    free(r->slot);
+    free(r);
+}
+
+size_t spsc_push(spsc_t *r, element_t **e, size_t n)
+{
+    size_t tail = atomic_load_explicit(&r->prod.tail, memory_order_relaxed);
+    size_t room = r->mask + 1 - (tail - r->prod.head_cache);
+    if (room < n) {
+        r->prod.head_cache =
+            atomic_load_explicit(&r->cons.head, memory_order_acquire);
+        room = r->mask + 1 - (tail - r->prod.head_cache);
+        if (n > room)
+            n = room;
+    }
+    for (size_t i = 0; i < n; i++)
+        r->slot[(tail + i) & r->mask] = e[i];
+    /* One release store publishes the whole batch */
+    atomic_store_explicit(&r->prod.tail, tail + n, memory_order_release);
+    return n;
+}
+
+size_t spsc_pop(spsc_t *r, element_t **e, size_t n)
+{
+    size_t head = atomic_load_explicit(&r->cons.head, memory_order_relaxed);
+    size_t avail = r->cons.tail_cache - head;
+    if (avail < n) {
+        r->cons.tail_cache =
+            atomic_load_explicit(&r->prod.tail, memory_order_acquire);
+        avail = r->cons.tail_cache - head;
+        if (n > avail)
+            n = avail;
+    }
+    for (size_t i = 0; i < n; i++)
+        e[i] = r->slot[(head + i) & r->mask];
+    /* Slots go back to the producer only after they have been read */
+    atomic_store_explicit(&r->cons.head, head + n, memory_order_release);
+    return n;
+}
+
+bool spsc_insert_tail(spsc_t *r, char *s)
+{
+    if (!(r && s))
+        return false;
+    element_t *e = q_new_element(s);
+    if (!e)
+        return false;
+    if (!spsc_push(r, &e, 1)) {
+        q_release_element(e);
+        return false;
+    }
+    return true;
+}
+
+element_t *spsc_remove_head(spsc_t *r, char *sp, size_t bufsize)
+{
+    element_t *e;
+    if (!r || !spsc_pop(r, &e, 1))
+        return NULL;
+    if (sp) {
+        size_t len = strnlen(e->value, bufsize - 1);
+        memcpy(sp, e->value, len);
+        sp[len] = 0;
+    }
+    return e;
+}
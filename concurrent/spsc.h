@@ -0,0 +1,82 @@
+#ifndef LAB0_SPSC_H
+#define LAB0_SPSC_H
+
+/* Bounded wait-free ring of elements for exactly one producer thread and one
+ * consumer thread.
+ *
+ * Each side owns one index and keeps a cached copy of the other one, so it
+ * only reads the shared index of the other side when the cached copy says
+ * the ring is full (producer) or empty (consumer). Batches publish or
+ * consume any number of elements with a single release store.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+typedef struct spsc spsc_t;
+
+/**
+ * spsc_new() - Create an empty ring
+ * @cap: number of slots, rounded up to a power of two
+ *
+ * Return: NULL for allocation failed or @cap of zero
+ */
+spsc_t *spsc_new(size_t cap);
+
+/**
+ * spsc_free() - Free the ring and the elements still in it
+ * @r: ring, no effect if NULL
+ *
+ * Neither side may be using the ring any more.
+ */
+void spsc_free(spsc_t *r);
+
+/**
+ * spsc_push() - Publish elements at the tail, producer only
+ * @r: ring
+ * @e: elements to publish, in order
+ * @n: number of elements in @e
+ *
+ * The ring takes over the elements published.
+ *
+ * Return: how many of the first elements of @e were published, fewer than
+ * @n if the ring filled up
+ */
+size_t spsc_push(spsc_t *r, element_t **e, size_t n);
+
+/**
+ * spsc_pop() - Consume elements from the head, consumer only
+ * @r: ring
+ * @e: where to store the elements removed, in order
+ * @n: room in @e
+ *
+ * The caller takes over the elements and releases them with
+ * q_release_element().
+ *
+ * Return: number of elements removed, zero if the ring was empty
+ */
+size_t spsc_pop(spsc_t *r, element_t **e, size_t n);
+
+/**
+ * spsc_insert_tail() - Insert a copy of a string at the tail, producer only
+ * @r: ring
+ * @s: string to be stored
+ *
+ * Return: false for allocation failed, ring full or NULL arguments
+ */
+bool spsc_insert_tail(spsc_t *r, char *s);
+
+/**
+ * spsc_remove_head() - Remove the element at the head, consumer only
+ * @r: ring
+ * @sp: buffer to copy the removed string to, or NULL
+ * @bufsize: size of @sp
+ *
+ * Same ownership as q_remove_head().
+ *
+ * Return: the element removed, NULL if the ring is NULL or was empty
+ */
+element_t *spsc_remove_head(spsc_t *r, char *sp, size_t bufsize);
+
+#endif /* LAB0_SPSC_H */
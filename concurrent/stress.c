@@ -0,0 +1,886 @@
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Bookkeeping of the checks is internal, only the elements are tested */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "bq.h"
+#include "estack.h"
+#include "fc.h"
+#include "hp.h"
+#include "msq.h"
+#include "report.h"
+#include "shardq.h"
+#include "spsc.h"
+#include "stress.h"
+#include "tlq.h"
+
+#define STRESS_STRLEN 48
+
+/* Digits of the time stamp some strings end with, filled in when sent */
+#define STAMP_WIDTH 19
+
+/* Start a worker that leaves signals such as the alarm of the time limit to
+ * the qtest thread, which is the one that may longjmp. Faults of the worker
+ * are still reported.
+ */
+static bool spawn(pthread_t *tid, void *(*fn)(void *), void *arg)
+{
+    sigset_t old;
+    block_async_signals(&old);
+    int err = pthread_create(tid, NULL, fn, arg);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return !err;
+}
+
+struct stress {
+    msq_t *q;
+    int producers, n;
+    long total;
+    atomic_long consumed;
+    atomic_bool stop; /* a check failed or a thread could not start */
+};
+
+static long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* Elements are made before the clock starts and released after it stops,
+ * so that the benchmarks measure the queues and not the test allocator,
+ * whose bookkeeping is all under one lock.
+ */
+struct worker {
+    pthread_t tid;
+    void *s; /* the run it takes part in */
+    int id;
+    element_t **send; /* to be inserted, entries are cleared once they are */
+    int nsend;
+    struct list_head got; /* removed, waiting to be released */
+};
+
+/* Make the elements "id:seq" of a worker, followed by a blank time stamp if
+ * stamped
+ */
+static bool worker_init(struct worker *w, void *s, int id, int nsend,
+                        bool stamped)
+{
+    w->s = s;
+    w->id = id;
+    w->nsend = nsend;
+    INIT_LIST_HEAD(&w->got);
+    w->send = nsend ? calloc(nsend, sizeof(element_t *)) : NULL;
+    if (nsend && !w->send)
+        return false;
+
+    char buf[STRESS_STRLEN];
+    for (int seq = 0; seq < nsend; seq++) {
+        if (stamped)
+            snprintf(buf, sizeof(buf), "%d:%d:%0*d", id, seq, STAMP_WIDTH, 0);
+        else
+            snprintf(buf, sizeof(buf), "%d:%d", id, seq);
+        /* Fail like any command when allocation is set to fail, the
+         * caller releases what was made so far
+         */
+        w->send[seq] = q_new_element(buf);
+        if (!w->send[seq])
+            return false;
+    }
+    return true;
+}
+
+/* Release what a worker did not insert and what it removed */
+static void worker_release(struct worker *w)
+{
+    for (int i = 0; w->send && i < w->nsend; i++) {
+        if (w->send[i])
+            q_release_element(w->send[i]);
+    }
+    free(w->send);
+    w->send = NULL;
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, &w->got, list)
+        q_release_element(e);
+    INIT_LIST_HEAD(&w->got);
+}
+
+/* Set up count workers for the run s, those in [from, to) sending n elements
+ * each. Senders and the others are numbered from 0 apart. Return NULL for
+ * allocation failed.
+ */
+static struct worker *workers_new(void *s,
+                                  int count,
+                                  int from,
+                                  int to,
+                                  int n,
+                                  bool stamped)
+{
+    struct worker *w = calloc(count, sizeof(struct worker));
+    if (!w)
+        return NULL;
+    for (int i = 0; i < count; i++)
+        INIT_LIST_HEAD(&w[i].got);
+    for (int i = 0; i < count; i++) {
+        bool sender = i >= from && i < to;
+        int id = sender ? i - from : i < from ? i : i - (to - from);
+        if (!worker_init(&w[i], s, id, sender ? n : 0, stamped)) {
+            for (int k = 0; k <= i; k++)
+                worker_release(&w[k]);
+            free(w);
+            return NULL;
+        }
+    }
+    return w;
+}
+
+static void workers_free(struct worker *w, int count)
+{
+    for (int i = 0; i < count; i++)
+        worker_release(&w[i]);
+    free(w);
+}
+
+/* Write the current time into the blank stamp of e, keeping its cached key
+ * and hash in step with the new string
+ */
+static void stamp(element_t *e)
+{
+    char *end = e->value + strlen(e->value);
+    snprintf(end - STAMP_WIDTH, STAMP_WIDTH + 1, "%0*ld", STAMP_WIDTH,
+             now_ns());
+    q_rekey_element(e);
+}
+
+static void *producer(void *arg)
+{
+    struct worker *w = arg;
+    struct stress *s = w->s;
+    for (int seq = 0; seq < s->n && !atomic_load(&s->stop); seq++) {
+        while (!msq_insert_element(s->q, w->send[seq])) {
+            if (atomic_load(&s->stop))
+                return NULL;
+            sched_yield();
+        }
+        w->send[seq] = NULL;
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    struct worker *w = arg;
+    struct stress *s = w->s;
+    int *last = malloc(s->producers * sizeof(int));
+    if (!last) {
+        atomic_store(&s->stop, true);
+        return NULL;
+    }
+    for (int p = 0; p < s->producers; p++)
+        last[p] = -1;
+
+    char buf[STRESS_STRLEN];
+    while (atomic_load(&s->consumed) < s->total && !atomic_load(&s->stop)) {
+        element_t *e = msq_remove_head(s->q, buf, sizeof(buf));
+        if (!e) {
+            sched_yield();
+            continue;
+        }
+        int p, seq;
+        if (sscanf(buf, "%d:%d", &p, &seq) != 2 || p < 0 ||
+            p >= s->producers || seq <= last[p])
+            atomic_store(&s->stop, true);
+        else
+            last[p] = seq;
+        list_add_tail(&e->list, &w->got);
+        atomic_fetch_add(&s->consumed, 1);
+    }
+    free(last);
+    return NULL;
+}
+
+bool stress_mpmc(int producers, int consumers, int n, double *ops_per_sec)
+{
+    struct stress s = {
+        .q = msq_new(),
+        .producers = producers,
+        .n = n,
+        .total = (long) producers * n,
+    };
+    atomic_init(&s.consumed, 0);
+    atomic_init(&s.stop, false);
+    int nworkers = producers + consumers;
+    struct worker *w =
+        s.q ? workers_new(&s, nworkers, 0, producers, n, false) : NULL;
+    if (!w) {
+        msq_free(s.q);
+        return false;
+    }
+
+    double t;
+    init_time(&t);
+    int started = 0;
+    for (; started < nworkers; started++) {
+        if (!spawn(&w[started].tid, started < producers ? producer : consumer,
+                   &w[started])) {
+            atomic_store(&s.stop, true);
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(w[i].tid, NULL);
+    double elapsed = delta_time(&t);
+
+    bool ok = !atomic_load(&s.stop) && atomic_load(&s.consumed) == s.total;
+    element_t *e = msq_remove_head(s.q, NULL, 0);
+    if (e) {
+        /* More strings than were inserted */
+        q_release_element(e);
+        ok = false;
+    }
+    if (ops_per_sec)
+        *ops_per_sec = elapsed > 0 ? 2.0 * s.total / elapsed : 0;
+
+    msq_free(s.q);
+    hp_drain();
+    workers_free(w, nworkers);
+    return ok;
+}
+
+struct spsc_run {
+    spsc_t *r;
+    int n, batch;
+    atomic_bool stop;
+    double latency_ns; /* summed by the consumer */
+};
+
+static void *spsc_producer(void *arg)
+{
+    struct worker *w = arg;
+    struct spsc_run *s = w->s;
+    for (int seq = 0; seq < s->n && !atomic_load(&s->stop);) {
+        size_t k = s->n - seq < s->batch ? s->n - seq : s->batch;
+        element_t **e = w->send + seq;
+        for (size_t i = 0; i < k; i++)
+            stamp(e[i]);
+        size_t sent = 0;
+        while (sent < k && !atomic_load(&s->stop)) {
+            size_t m = spsc_push(s->r, e + sent, k - sent);
+            if (!m)
+                sched_yield();
+            sent += m;
+        }
+        for (size_t i = 0; i < sent; i++)
+            e[i] = NULL;
+        seq += k;
+    }
+    return NULL;
+}
+
+static void *spsc_consumer(void *arg)
+{
+    struct worker *w = arg;
+    struct spsc_run *s = w->s;
+    element_t **e = malloc(s->batch * sizeof(element_t *));
+    if (!e) {
+        atomic_store(&s->stop, true);
+        return NULL;
+    }
+    int expect = 0;
+    while (expect < s->n && !atomic_load(&s->stop)) {
+        size_t k = spsc_pop(s->r, e, s->batch);
+        if (!k) {
+            sched_yield();
+            continue;
+        }
+        long now = now_ns();
+        for (size_t i = 0; i < k; i++) {
+            int p, seq;
+            long sent;
+            if (sscanf(e[i]->value, "%d:%d:%ld", &p, &seq, &sent) != 3 ||
+                seq != expect)
+                atomic_store(&s->stop, true);
+            expect++;
+            s->latency_ns += now - sent;
+            list_add_tail(&e[i]->list, &w->got);
+        }
+    }
+    free(e);
+    return NULL;
+}
+
+bool stress_spsc(int n,
+                 int batch,
+                 int cap,
+                 double *ops_per_sec,
+                 double *latency_ns)
+{
+    struct spsc_run s = {
+        .r = spsc_new(cap),
+        .n = n,
+        .batch = batch,
+    };
+    atomic_init(&s.stop, false);
+    struct worker *w = s.r ? workers_new(&s, 2, 0, 1, n, true) : NULL;
+    if (!w) {
+        spsc_free(s.r);
+        return false;
+    }
+
+    double t;
+    init_time(&t);
+    bool started = spawn(&w[0].tid, spsc_producer, &w[0]);
+    if (started && !spawn(&w[1].tid, spsc_consumer, &w[1])) {
+        atomic_store(&s.stop, true);
+        pthread_join(w[0].tid, NULL);
+        started = false;
+    }
+    if (started) {
+        pthread_join(w[0].tid, NULL);
+        pthread_join(w[1].tid, NULL);
+    }
+    double elapsed = delta_time(&t);
+
+    bool ok = started && !atomic_load(&s.stop);
+    element_t *e = spsc_remove_head(s.r, NULL, 0);
+    if (e) {
+        /* More strings than were sent */
+        q_release_element(e);
+        ok = false;
+    }
+    if (ops_per_sec)
+        *ops_per_sec = elapsed > 0 ? 2.0 * n / elapsed : 0;
+    if (latency_ns)
+        *latency_ns = s.latency_ns / n;
+    spsc_free(s.r);
+    workers_free(w, 2);
+    return ok;
+}
+
+/* A shared queue under benchmark, behind a uniform interface */
+struct bench_queue {
+    void *q;
+    bool (*insert)(void *q, element_t *e);
+    element_t *(*remove)(void *q, char *sp, size_t bufsize);
+};
+
+struct bench_run {
+    const struct bench_queue *bq;
+    int n;
+    atomic_long removed;
+};
+
+/* Insert then remove, n times over. The queue never runs dry for long, so
+ * both ends are busy all the time.
+ */
+static void *bench_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct bench_run *b = w->s;
+    const struct bench_queue *bq = b->bq;
+    long removed = 0;
+    for (int i = 0; i < b->n; i++) {
+        while (!bq->insert(bq->q, w->send[i]))
+            sched_yield();
+        w->send[i] = NULL;
+        element_t *e = bq->remove(bq->q, NULL, 0);
+        if (e) {
+            list_add_tail(&e->list, &w->got);
+            removed++;
+        }
+    }
+    atomic_fetch_add(&b->removed, removed);
+    return NULL;
+}
+
+/* Run threads workers on bq and return ops/sec, negative if strings were
+ * lost or a thread could not start
+ */
+static double bench_run(const struct bench_queue *bq, int threads, int n)
+{
+    struct bench_run b = {.bq = bq, .n = n};
+    atomic_init(&b.removed, 0);
+    struct worker *w = workers_new(&b, threads, 0, threads, n, false);
+    if (!w)
+        return -1;
+
+    double t;
+    init_time(&t);
+    int started = 0;
+    while (started < threads &&
+           spawn(&w[started].tid, bench_worker, &w[started]))
+        started++;
+    for (int i = 0; i < started; i++)
+        pthread_join(w[i].tid, NULL);
+    double elapsed = delta_time(&t);
+    workers_free(w, threads);
+
+    long left = 0;
+    for (element_t *e; (e = bq->remove(bq->q, NULL, 0)); left++)
+        q_release_element(e);
+    if (started < threads ||
+        atomic_load(&b.removed) + left != (long) n * threads)
+        return -1;
+    return elapsed > 0 ? 2.0 * n * threads / elapsed : 0;
+}
+
+/* The baseline: a plain list.h queue, one mutex around everything */
+struct locked_list {
+    pthread_mutex_t lock;
+    struct list_head head;
+};
+
+static bool locked_insert(void *q, element_t *e)
+{
+    struct locked_list *l = q;
+    pthread_mutex_lock(&l->lock);
+    list_add_tail(&e->list, &l->head);
+    pthread_mutex_unlock(&l->lock);
+    return true;
+}
+
+static bool locked_push(void *q, element_t *e)
+{
+    struct locked_list *l = q;
+    pthread_mutex_lock(&l->lock);
+    list_add(&e->list, &l->head);
+    pthread_mutex_unlock(&l->lock);
+    return true;
+}
+
+static element_t *locked_remove(void *q, char *sp, size_t bufsize)
+{
+    struct locked_list *l = q;
+    pthread_mutex_lock(&l->lock);
+    if (list_empty(&l->head)) {
+        pthread_mutex_unlock(&l->lock);
+        return NULL;
+    }
+    element_t *e = list_first_entry(&l->head, element_t, list);
+    list_del(&e->list);
+    pthread_mutex_unlock(&l->lock);
+    return e;
+}
+
+static bool tlq_insert(void *q, element_t *e)
+{
+    return tlq_insert_element(q, e);
+}
+
+static element_t *tlq_remove(void *q, char *sp, size_t bufsize)
+{
+    return tlq_remove_head(q, sp, bufsize);
+}
+
+bool bench_twolock(int threads, int n, double *twolock, double *global)
+{
+    struct locked_list l = {.lock = PTHREAD_MUTEX_INITIALIZER};
+    INIT_LIST_HEAD(&l.head);
+    struct bench_queue bq = {&l, locked_insert, locked_remove};
+    *global = bench_run(&bq, threads, n);
+
+    bq = (struct bench_queue){tlq_new(), tlq_insert, tlq_remove};
+    if (!bq.q)
+        return false;
+    *twolock = bench_run(&bq, threads, n);
+    tlq_free(bq.q);
+    return *twolock >= 0 && *global >= 0;
+}
+
+/* Consumers wake up this often to see if everything has arrived */
+#define BQ_POLL_MS 10
+
+struct bq_run {
+    bq_t *q;
+    int producers, n;
+    long total;
+    int *last; /* per consumer, last sequence number seen of each producer */
+    atomic_long consumed, latency_ns, timeouts;
+    atomic_bool stop;
+};
+
+static void *bq_producer(void *arg)
+{
+    struct worker *w = arg;
+    struct bq_run *s = w->s;
+    for (int seq = 0; seq < s->n && !atomic_load(&s->stop); seq++) {
+        stamp(w->send[seq]);
+        bq_insert_element(s->q, w->send[seq]);
+        w->send[seq] = NULL;
+    }
+    return NULL;
+}
+
+static void *bq_consumer(void *arg)
+{
+    struct worker *w = arg;
+    struct bq_run *s = w->s;
+    int *last = s->last + (size_t) w->id * s->producers;
+    char buf[STRESS_STRLEN];
+    long latency = 0, timeouts = 0;
+    while (atomic_load(&s->consumed) < s->total && !atomic_load(&s->stop)) {
+        element_t *e = bq_remove_head(s->q, buf, sizeof(buf), BQ_POLL_MS);
+        if (!e) {
+            timeouts++;
+            continue;
+        }
+        long now = now_ns(), sent;
+        int p, seq;
+        if (sscanf(buf, "%d:%d:%ld", &p, &seq, &sent) != 3 || p < 0 ||
+            p >= s->producers || seq <= last[p])
+            atomic_store(&s->stop, true);
+        else
+            last[p] = seq;
+        latency += now - sent;
+        list_add_tail(&e->list, &w->got);
+        atomic_fetch_add(&s->consumed, 1);
+    }
+    atomic_fetch_add(&s->latency_ns, latency);
+    atomic_fetch_add(&s->timeouts, timeouts);
+    return NULL;
+}
+
+bool bench_blocking(int producers,
+                    int consumers,
+                    int n,
+                    int cap,
+                    double *ops_per_sec,
+                    double *latency_ns,
+                    long *timeouts)
+{
+    struct bq_run s = {
+        .q = bq_new(cap),
+        .producers = producers,
+        .n = n,
+        .total = (long) producers * n,
+    };
+    atomic_init(&s.consumed, 0);
+    atomic_init(&s.latency_ns, 0);
+    atomic_init(&s.timeouts, 0);
+    atomic_init(&s.stop, false);
+    /* Consumers first: if a thread fails to start, no producer can be left
+     * waiting for room in a queue nobody drains
+     */
+    int nworkers = producers + consumers;
+    struct worker *w =
+        s.q ? workers_new(&s, nworkers, consumers, nworkers, n, true) : NULL;
+    s.last = malloc((size_t) consumers * producers * sizeof(int));
+    if (!w || !s.last) {
+        bq_free(s.q);
+        if (w)
+            workers_free(w, nworkers);
+        free(s.last);
+        return false;
+    }
+    for (size_t i = 0; i < (size_t) consumers * producers; i++)
+        s.last[i] = -1;
+
+    double t;
+    init_time(&t);
+    int started = 0;
+    for (; started < nworkers; started++) {
+        bool cons = started < consumers;
+        if (!spawn(&w[started].tid, cons ? bq_consumer : bq_producer,
+                   &w[started])) {
+            atomic_store(&s.stop, true);
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(w[i].tid, NULL);
+    double elapsed = delta_time(&t);
+
+    long consumed = atomic_load(&s.consumed);
+    bool ok = !atomic_load(&s.stop) && consumed == s.total;
+    element_t *e = bq_remove_head(s.q, NULL, 0, 0);
+    if (e) {
+        q_release_element(e);
+        ok = false;
+    }
+    *ops_per_sec = elapsed > 0 ? 2.0 * s.total / elapsed : 0;
+    *latency_ns = consumed ? (double) atomic_load(&s.latency_ns) / consumed : 0;
+    *timeouts = atomic_load(&s.timeouts);
+
+    bq_free(s.q);
+    workers_free(w, nworkers);
+    free(s.last);
+    return ok;
+}
+
+/* Elimination slots of the benchmarked stack */
+#define BENCH_ELIM_SLOTS 8
+
+static bool estack_insert(void *q, element_t *e)
+{
+    return estack_push_element(q, e);
+}
+
+static element_t *estack_remove(void *q, char *sp, size_t bufsize)
+{
+    return estack_pop(q, sp, bufsize);
+}
+
+bool bench_stack(int threads,
+                 int n,
+                 double *elim,
+                 double *plain,
+                 double *global,
+                 long *eliminated)
+{
+    struct locked_list l = {.lock = PTHREAD_MUTEX_INITIALIZER};
+    INIT_LIST_HEAD(&l.head);
+    struct bench_queue bq = {&l, locked_push, locked_remove};
+    *global = bench_run(&bq, threads, n);
+
+    bq = (struct bench_queue){estack_new(0), estack_insert, estack_remove};
+    if (!bq.q)
+        return false;
+    *plain = bench_run(&bq, threads, n);
+    estack_free(bq.q);
+
+    bq.q = estack_new(BENCH_ELIM_SLOTS);
+    if (!bq.q)
+        return false;
+    *elim = bench_run(&bq, threads, n);
+    *eliminated = estack_eliminated(bq.q);
+    estack_free(bq.q);
+    hp_drain();
+    return *elim >= 0 && *plain >= 0 && *global >= 0;
+}
+
+/* Distinct strings the flat combining threads insert, few enough for
+ * delete_dup to find some
+ */
+#define FC_KEYS 64
+
+struct fc_run {
+    fc_t *fc;
+    int n;
+    atomic_long delta; /* inserted less removed and deleted */
+};
+
+static void *fc_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct fc_run *s = w->s;
+    unsigned int seed = w->id + 1;
+    char buf[STRESS_STRLEN];
+    long delta = 0;
+    for (int i = 0; i < s->n; i++) {
+        int r = rand_r(&seed);
+        switch (r % 64) {
+        case 0:
+            fc_sort(s->fc);
+            break;
+        case 1:
+            fc_reverse(s->fc);
+            break;
+        case 2:
+            fc_swap(s->fc);
+            break;
+        case 3: {
+            int deleted = fc_delete_dup(s->fc);
+            if (deleted > 0)
+                delta -= deleted;
+            break;
+        }
+        default:
+            if (r & 64) {
+                snprintf(buf, sizeof(buf), "k%d", (r >> 7) % FC_KEYS);
+                delta += fc_insert_tail(s->fc, buf);
+            } else {
+                element_t *e = fc_remove_head(s->fc, NULL, 0);
+                if (e) {
+                    w->send[i] = e;
+                    delta--;
+                }
+            }
+        }
+    }
+    atomic_fetch_add(&s->delta, delta);
+    return NULL;
+}
+
+bool bench_fc(struct list_head *head,
+              int threads,
+              int n,
+              bool combining,
+              double *ops_per_sec,
+              double *batch)
+{
+    struct fc_run s = {.fc = fc_new(head, combining), .n = n};
+    atomic_init(&s.delta, 0);
+    /* Inserts allocate on the combiner only, one thread at a time */
+    struct worker *w = s.fc ? workers_new(&s, threads, 0, 0, 0, false) : NULL;
+    if (!w) {
+        fc_free(s.fc);
+        return false;
+    }
+    /* Removed elements wait in send, those of a pool or unrolled queue have
+     * no list node to link them into got
+     */
+    for (int i = 0; i < threads; i++) {
+        w[i].send = calloc(n, sizeof(element_t *));
+        if (!w[i].send) {
+            fc_free(s.fc);
+            workers_free(w, threads);
+            return false;
+        }
+        w[i].nsend = n;
+    }
+
+    int before = q_size(head);
+    double t;
+    init_time(&t);
+    int started = 0;
+    for (; started < threads; started++) {
+        if (!spawn(&w[started].tid, fc_worker, &w[started]))
+            break;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(w[i].tid, NULL);
+    double elapsed = delta_time(&t);
+
+    long calls, batches;
+    fc_stats(s.fc, &calls, &batches);
+    *ops_per_sec = elapsed > 0 ? calls / elapsed : 0;
+    *batch = batches ? (double) calls / batches : 0;
+
+    /* The size field and a walk of the queue must both agree */
+    int walked = 0;
+    q_iter_t it;
+    for (element_t *e = q_iter_first(&it, head); e; e = q_iter_next(&it))
+        walked++;
+    bool ok = started == threads && q_size(head) == before + s.delta &&
+              walked == q_size(head);
+    fc_free(s.fc);
+    workers_free(w, threads);
+    return ok;
+}
+
+/* A queue whose calls say which worker makes them */
+struct owner_queue {
+    void *q;
+    bool (*insert)(void *q, int id, element_t *e);
+    element_t *(*remove)(void *q, int id);
+};
+
+struct owner_run {
+    const struct owner_queue *oq;
+    int n;
+    atomic_long inserted, removed;
+};
+
+static void *owner_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct owner_run *s = w->s;
+    const struct owner_queue *oq = s->oq;
+    /* Out of every four calls, even workers insert three times and odd
+     * ones once, so the odd ones run dry and have to find work elsewhere
+     */
+    int inserts = w->id % 2 ? 1 : 3;
+    long inserted = 0, removed = 0;
+    for (int i = 0; i < s->n; i++) {
+        if (i % 4 < inserts) {
+            if (oq->insert(oq->q, w->id, w->send[i])) {
+                w->send[i] = NULL;
+                inserted++;
+            }
+        } else {
+            element_t *e = oq->remove(oq->q, w->id);
+            if (e) {
+                list_add_tail(&e->list, &w->got);
+                removed++;
+            }
+        }
+    }
+    atomic_fetch_add(&s->inserted, inserted);
+    atomic_fetch_add(&s->removed, removed);
+    return NULL;
+}
+
+/* Run threads workers on oq and return ops/sec, negative if strings were
+ * lost or a thread could not start
+ */
+static double owner_bench(const struct owner_queue *oq, int threads, int n)
+{
+    struct owner_run s = {.oq = oq, .n = n};
+    atomic_init(&s.inserted, 0);
+    atomic_init(&s.removed, 0);
+    /* Element i is sent by the call i, if that call is an insert */
+    struct worker *w = workers_new(&s, threads, 0, threads, n, false);
+    if (!w)
+        return -1;
+
+    double t;
+    init_time(&t);
+    int started = 0;
+    for (; started < threads; started++) {
+        if (!spawn(&w[started].tid, owner_worker, &w[started]))
+            break;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(w[i].tid, NULL);
+    double elapsed = delta_time(&t);
+    workers_free(w, threads);
+
+    /* The workers are gone, any of their shards can be drained from here */
+    long left = 0;
+    for (int id = 0; id < threads; id++) {
+        for (element_t *e; (e = oq->remove(oq->q, id)); left++)
+            q_release_element(e);
+    }
+    if (started < threads ||
+        atomic_load(&s.removed) + left != atomic_load(&s.inserted))
+        return -1;
+    return elapsed > 0 ? (double) n * threads / elapsed : 0;
+}
+
+static bool shard_insert(void *q, int id, element_t *e)
+{
+    return shardq_insert_element(q, id, e);
+}
+
+static element_t *shard_remove(void *q, int id)
+{
+    return shardq_remove(q, id, NULL, 0);
+}
+
+static bool global_insert(void *q, int id, element_t *e)
+{
+    return locked_insert(q, e);
+}
+
+static element_t *global_remove(void *q, int id)
+{
+    return locked_remove(q, NULL, 0);
+}
+
+bool bench_shard(int threads,
+                 int n,
+                 double *sharded,
+                 double *global,
+                 long *steals)
+{
+    struct locked_list l = {.lock = PTHREAD_MUTEX_INITIALIZER};
+    INIT_LIST_HEAD(&l.head);
+    struct owner_queue oq = {&l, global_insert, global_remove};
+    *global = owner_bench(&oq, threads, n);
+
+    oq = (struct owner_queue){shardq_new(threads), shard_insert, shard_remove};
+    if (!oq.q)
+        return false;
+    *sharded = owner_bench(&oq, threads, n);
+    *steals = shardq_steals(oq.q);
+    shardq_free(oq.q);
+    return *sharded >= 0 && *global >= 0;
+}
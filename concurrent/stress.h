@@ -0,0 +1,136 @@
+#ifndef LAB0_STRESS_H
+#define LAB0_STRESS_H
+
+/* Multi-threaded stress tests and throughput benchmarks of the concurrent
+ * queues
+ */
+
+#include <stdbool.h>
+#include "list.h"
+
+/**
+ * stress_mpmc() - Run producers and consumers on one lock-free queue
+ * @producers: number of producer threads
+ * @consumers: number of consumer threads
+ * @n: strings each producer inserts
+ * @ops_per_sec: where to store the inserts and removes per second, or NULL
+ *
+ * Producer p inserts "p:0" to "p:n-1" in order. Consumers remove strings
+ * until all are gone, checking that the strings of each producer come out
+ * in the order they went in and that none is lost or seen twice.
+ *
+ * Return: true if all checks passed
+ */
+bool stress_mpmc(int producers, int consumers, int n, double *ops_per_sec);
+
+/**
+ * stress_spsc() - Stream strings from one thread to another through a ring
+ * @n: strings to send
+ * @batch: strings published or consumed at once
+ * @cap: slots of the ring
+ * @ops_per_sec: where to store the inserts and removes per second, or NULL
+ * @latency_ns: where to store the mean time from creating an element to
+ *              removing it, or NULL
+ *
+ * The consumer checks that the strings arrive in order and none is lost.
+ *
+ * Return: true if all checks passed
+ */
+bool stress_spsc(int n,
+                 int batch,
+                 int cap,
+                 double *ops_per_sec,
+                 double *latency_ns);
+
+/**
+ * bench_twolock() - Compare the two-lock queue with a globally locked list
+ * @threads: number of threads, each inserting and removing in turn
+ * @n: strings each thread inserts
+ * @twolock: where to store the ops/sec of the two-lock queue
+ * @global: where to store the ops/sec of a list.h queue behind one mutex
+ *
+ * Return: true if no string got lost in either queue
+ */
+bool bench_twolock(int threads, int n, double *twolock, double *global);
+
+/**
+ * bench_blocking() - Run producers and consumers on a blocking queue
+ * @producers: number of producer threads
+ * @consumers: number of consumer threads, parked whenever the queue is empty
+ * @n: strings each producer inserts
+ * @cap: capacity of the queue, 0 for no limit
+ * @ops_per_sec: where to store the inserts and removes per second
+ * @latency_ns: where to store the mean time from calling insert to removal
+ * @timeouts: where to store how often a consumer's timed wait expired
+ *
+ * Consumers check the per-producer order and the count, as stress_mpmc().
+ *
+ * Return: true if all checks passed
+ */
+bool bench_blocking(int producers,
+                    int consumers,
+                    int n,
+                    int cap,
+                    double *ops_per_sec,
+                    double *latency_ns,
+                    long *timeouts);
+
+/**
+ * bench_stack() - Compare stacks under contention
+ * @threads: number of threads, each pushing and popping in turn
+ * @n: strings each thread pushes
+ * @elim: where to store the ops/sec of the elimination-backoff stack
+ * @plain: where to store the ops/sec of the same stack without elimination
+ * @global: where to store the ops/sec of a list.h stack behind one mutex
+ * @eliminated: where to store how many pushes were eliminated
+ *
+ * Return: true if no string got lost in any stack
+ */
+bool bench_stack(int threads,
+                 int n,
+                 double *elim,
+                 double *plain,
+                 double *global,
+                 long *eliminated);
+
+/**
+ * bench_fc() - Share a queue among threads through flat combining
+ * @head: queue to work on
+ * @threads: number of threads
+ * @n: calls each thread makes
+ * @combining: false to lock around each call instead
+ * @ops_per_sec: where to store the calls per second
+ * @batch: where to store the mean number of calls run per lock taken
+ *
+ * Threads mostly insert at the tail and remove from the head, now and then
+ * sorting, reversing, swapping or deleting duplicates. The final size is
+ * checked against what every thread inserted, removed and deleted.
+ *
+ * Return: true if the check passed
+ */
+bool bench_fc(struct list_head *head,
+              int threads,
+              int n,
+              bool combining,
+              double *ops_per_sec,
+              double *batch);
+
+/**
+ * bench_shard() - Compare the sharded queue with a globally locked list
+ * @threads: number of threads, even ones inserting more than they remove
+ *           and odd ones the other way round
+ * @n: calls each thread makes
+ * @sharded: where to store the ops/sec of the sharded queue
+ * @global: where to store the ops/sec of a list.h queue behind one mutex
+ * @steals: where to store how many batches the sharded queue moved
+ *          between shards
+ *
+ * Return: true if no string got lost in either queue
+ */
+bool bench_shard(int threads,
+                 int n,
+                 double *sharded,
+                 double *global,
+                 long *steals);
+
+#endif /* LAB0_STRESS_H */
@@ -0,0 +1,127 @@
+/* Michael and Scott, "Simple, Fast, and Practical Non-Blocking and Blocking
+ * Concurrent Queue Algorithms", PODC 1996, the two-lock queue.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes are internal, only the elements count as blocks of the tests */
+#define INTERNAL 1
+#include "harness.h"
+
+#include "tlq.h"
+
+#define CACHE_LINE 64
+
+/* The dummy node outlives the element it carried, which is why nodes are
+ * allocated apart from the elements instead of linking element_t.list
+ */
+struct tlq_node {
+    struct tlq_node *_Atomic next; /* written under the tail lock only */
+    element_t *e;
+};
+
+struct tlq {
+    struct {
+        _Alignas(CACHE_LINE) pthread_mutex_t lock;
+        struct tlq_node *node;
+    } head;
+    struct {
+        _Alignas(CACHE_LINE) pthread_mutex_t lock;
+        struct tlq_node *node;
+    } tail;
+};
+
+tlq_t *tlq_new(void)
+{
+    tlq_t *q = aligned_alloc(CACHE_LINE, sizeof(tlq_t));
+    struct tlq_node *dummy = malloc(sizeof(struct tlq_node));
+    if (!q || !dummy) {
+        free(q);
+        free(dummy);
+        return NULL;
+    }
+    atomic_init(&dummy->next, NULL);
+    dummy->e = NULL;
+    pthread_mutex_init(&q->head.lock, NULL);
+    pthread_mutex_init(&q->tail.lock, NULL);
+    q->head.node = q->tail.node = dummy;
+    return q;
+}
+
+void tlq_free(tlq_t *q)
+{
+    if (!q)
+        return;
+    struct tlq_node *n = q->head.node, *next = atomic_load(&n->next);
+    free(n);
+    for (n = next; n; n = next) {
+        next = atomic_load(&n->next);
+        q_release_element(n->e);
+        free(n);
+    }
+    pthread_mutex_destroy(&q->head.lock);
+    pthread_mutex_destroy(&q->tail.lock);
+    free(q);
+}
+
+bool tlq_insert_tail(tlq_t *q, char *s)
+{
+    if (!(q && s))
+        return false;
+    element_t *e = q_new_element(s);
+    if (!e)
+        return false;
+    if (!tlq_insert_element(q, e)) {
+        q_release_element(e);
+        return false;
+    }
+    return true;
+}
+
+bool tlq_insert_element(tlq_t *q, element_t *e)
+{
+    if (!(q && e))
+        return false;
+    struct tlq_node *node = malloc(sizeof(struct tlq_node));
+    if (!node)
+        return false;
+    atomic_init(&node->next, NULL);
+    node->e = e;
+
+    pthread_mutex_lock(&q->tail.lock);
+    /* Release: the remover sees the node filled in once it sees the link */
+    atomic_store_explicit(&q->tail.node->next, node, memory_order_release);
+    q->tail.node = node;
+    pthread_mutex_unlock(&q->tail.lock);
+    return true;
+}
+
+element_t *tlq_remove_head(tlq_t *q, char *sp, size_t bufsize)
+{
+    if (!q)
+        return NULL;
+
+    pthread_mutex_lock(&q->head.lock);
+    struct tlq_node *dummy = q->head.node;
+    struct tlq_node *first =
+        atomic_load_explicit(&dummy->next, memory_order_acquire);
+    if (!first) {
+        pthread_mutex_unlock(&q->head.lock);
+        return NULL;
+    }
+    /* first becomes the dummy, its element goes to the caller */
+    element_t *e = first->e;
+    q->head.node = first;
+    pthread_mutex_unlock(&q->head.lock);
+    free(dummy);
+
+    if (sp) {
+        size_t len = strnlen(e->value, bufsize - 1);
+        memcpy(sp, e->value, len);
+        sp[len] = 0;
+    }
+    return e;
+}
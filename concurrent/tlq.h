@@ -0,0 +1,62 @@
+#ifndef LAB0_TLQ_H
+#define LAB0_TLQ_H
+
+/* Concurrent FIFO queue of elements with one lock for each end.
+ *
+ * Michael and Scott's two-lock queue: a dummy node always sits in front,
+ * so inserting only ever touches the tail node and removing only the head
+ * node, and inserters and removers never wait for each other.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue.h"
+
+typedef struct tlq tlq_t;
+
+/**
+ * tlq_new() - Create an empty queue
+ *
+ * Return: NULL for allocation failed
+ */
+tlq_t *tlq_new(void);
+
+/**
+ * tlq_free() - Free the queue and the elements still in it
+ * @q: queue, no effect if NULL
+ *
+ * No other thread may be using the queue any more.
+ */
+void tlq_free(tlq_t *q);
+
+/**
+ * tlq_insert_tail() - Insert a copy of a string at the tail
+ * @q: queue
+ * @s: string to be stored
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool tlq_insert_tail(tlq_t *q, char *s);
+
+/**
+ * tlq_insert_element() - Insert an element made by the caller at the tail
+ * @q: queue
+ * @e: element from q_new_element(), owned by the queue on success
+ *
+ * Return: true for success, false for allocation failed or NULL arguments
+ */
+bool tlq_insert_element(tlq_t *q, element_t *e);
+
+/**
+ * tlq_remove_head() - Remove the element at the head
+ * @q: queue
+ * @sp: buffer to copy the removed string to, or NULL
+ * @bufsize: size of @sp
+ *
+ * Same ownership as q_remove_head().
+ *
+ * Return: the element removed, NULL if the queue is NULL or was empty
+ */
+element_t *tlq_remove_head(tlq_t *q, char *sp, size_t bufsize);
+
+#endif /* LAB0_TLQ_H */
@@ -25,6 +25,8 @@ const int drop_size = 20;
  */
 static struct list_head *l = NULL;
 
+struct list_head *(*dut_queue_new)(void) = q_new;
+
 static char random_string[N_MEASURE][8];
 static int random_string_iter = 0;
 
@@ -78,7 +80,7 @@ void measure(int64_t *before_ticks,
             dut_new();
             dut_insert_head(
                 get_random_string(),
-                *(uint16_t *) (input_data + i * chunk_size) % 10000);
+                *(uint16_t *) (input_data + i * chunk_size) % DUT_MAX_LEN);
             before_ticks[i] = cpucycles();
             dut_insert_head(s, 1);
             after_ticks[i] = cpucycles();
@@ -91,7 +93,7 @@ void measure(int64_t *before_ticks,
             dut_new();
             dut_insert_head(
                 get_random_string(),
-                *(uint16_t *) (input_data + i * chunk_size) % 10000);
+                *(uint16_t *) (input_data + i * chunk_size) % DUT_MAX_LEN);
             before_ticks[i] = cpucycles();
             dut_insert_tail(s, 1);
             after_ticks[i] = cpucycles();
@@ -103,7 +105,7 @@ void measure(int64_t *before_ticks,
             dut_new();
             dut_insert_head(
                 get_random_string(),
-                *(uint16_t *) (input_data + i * chunk_size) % 10000);
+                *(uint16_t *) (input_data + i * chunk_size) % DUT_MAX_LEN);
             before_ticks[i] = cpucycles();
             element_t *e = q_remove_head(l, NULL, 0);
             after_ticks[i] = cpucycles();
@@ -117,7 +119,7 @@ void measure(int64_t *before_ticks,
             dut_new();
             dut_insert_head(
                 get_random_string(),
-                *(uint16_t *) (input_data + i * chunk_size) % 10000);
+                *(uint16_t *) (input_data + i * chunk_size) % DUT_MAX_LEN);
             before_ticks[i] = cpucycles();
             element_t *e = q_remove_tail(l, NULL, 0);
             after_ticks[i] = cpucycles();
@@ -131,7 +133,7 @@ void measure(int64_t *before_ticks,
             dut_new();
             dut_insert_head(
                 get_random_string(),
-                *(uint16_t *) (input_data + i * chunk_size) % 10000);
+                *(uint16_t *) (input_data + i * chunk_size) % DUT_MAX_LEN);
             before_ticks[i] = cpucycles();
             dut_size(1);
             after_ticks[i] = cpucycles();
@@ -2,7 +2,16 @@
 #define DUDECT_CONSTANT_H
 
 #include <stdint.h>
-#define dut_new() ((void) (l = q_new()))
+
+/* Most elements a measured queue holds: fewer than this many inserted first,
+ * then the one measured
+ */
+#define DUT_MAX_LEN 10000
+
+/* Creates the queues measured, q_new() unless set otherwise */
+extern struct list_head *(*dut_queue_new)(void);
+
+#define dut_new() ((void) (l = dut_queue_new()))
 
 #define dut_size(n)                                \
     do {                                           \
@@ -1,7 +1,9 @@
 /* Test support code */
 
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +29,16 @@
 /* Byte to fill newly malloced space with */
 #define FILLCHAR 0x55
 
+/* Blocks up to SLAB_MAX_BLOCK bytes (header and footer included) are served
+ * from per-size-class free lists, with classes every SLAB_ALIGN bytes.
+ * Fresh blocks are carved from SLAB_CHUNK-sized chunks obtained from the
+ * system allocator; larger blocks go to malloc directly.
+ */
+#define SLAB_ALIGN 16
+#define SLAB_MAX_BLOCK 1024
+#define SLAB_CLASSES (SLAB_MAX_BLOCK / SLAB_ALIGN)
+#define SLAB_CHUNK (1 << 20)
+
 /* Data structures used by our code */
 
 /* Represent allocated blocks as doubly-linked list, with
@@ -43,6 +55,47 @@ typedef struct BELE {
 static block_ele_t *allocated = NULL;
 static size_t allocated_count = 0;
 
+/* Guards all the bookkeeping below, elements may be allocated and freed by
+ * several threads at once, e.g. by the concurrent queues
+ */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Whether the calling thread holds heap_lock. A longjmp out of a signal
+ * handler may leave the allocator, exception_setup() then releases the lock
+ * on behalf of this thread.
+ */
+static __thread volatile sig_atomic_t heap_held;
+
+static void heap_acquire(void)
+{
+    pthread_mutex_lock(&heap_lock);
+    heap_held = true;
+}
+
+static void heap_release(void)
+{
+    heap_held = false;
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/* Free blocks of each size class, linked through their next field */
+static block_ele_t *slab_free[SLAB_CLASSES];
+
+/* Unused tail of the chunk fresh blocks are carved from */
+static unsigned char *slab_cur = NULL, *slab_end = NULL;
+
+/* Chunks handed out so far, linked through their first word */
+static void *slab_chunks = NULL;
+
+/* Open-addressing hash set of live blocks, so that cautious mode can tell in
+ * O(1) whether a pointer is really allocated. Linear probing, kept at most
+ * half full; removal shifts the following entries back instead of leaving
+ * tombstones. Capacity is zero or a power of two.
+ */
+#define LIVE_MIN_CAP 1024
+static block_ele_t **live_set = NULL;
+static size_t live_cap = 0;
+
 /* Percent probability of malloc failure */
 int fail_probability = 0;
 
@@ -67,8 +120,81 @@ static bool fail_allocation()
     return (weight < 0.01 * fail_probability);
 }
 
+/* Home slot of block b in the live set */
+static size_t live_slot(const block_ele_t *b)
+{
+    uint64_t h = ((uintptr_t) b >> 4) * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h >> 32) & (live_cap - 1);
+}
+
+/* Slot holding block b, or the empty slot where it would go */
+static size_t live_find(const block_ele_t *b)
+{
+    size_t i = live_slot(b);
+    while (live_set[i] && live_set[i] != b)
+        i = (i + 1) & (live_cap - 1);
+    return i;
+}
+
+static bool live_contains(const block_ele_t *b)
+{
+    return live_cap && live_set[live_find(b)] == b;
+}
+
+/* Rehash the live set into a table of new_cap slots */
+static bool live_resize(size_t new_cap)
+{
+    block_ele_t **old_set = live_set;
+    size_t old_cap = live_cap;
+
+    live_set = calloc(new_cap, sizeof(block_ele_t *));
+    if (!live_set) {
+        live_set = old_set;
+        return false;
+    }
+    live_cap = new_cap;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old_set[i])
+            live_set[live_find(old_set[i])] = old_set[i];
+    }
+    free(old_set);
+    return true;
+}
+
+static bool live_insert(block_ele_t *b)
+{
+    if ((allocated_count + 1) * 2 > live_cap &&
+        !live_resize(live_cap ? live_cap * 2 : LIVE_MIN_CAP))
+        return false;
+    live_set[live_find(b)] = b;
+    return true;
+}
+
+static void live_remove(const block_ele_t *b)
+{
+    if (!live_cap)
+        return;
+    size_t hole = live_find(b);
+    if (!live_set[hole])
+        return;
+
+    /* Move back every entry whose probe sequence passes through the hole */
+    for (size_t i = (hole + 1) & (live_cap - 1); live_set[i];
+         i = (i + 1) & (live_cap - 1)) {
+        size_t home = live_slot(live_set[i]);
+        bool stays = hole <= i ? (hole < home && home <= i)
+                               : (hole < home || home <= i);
+        if (stays)
+            continue;
+        live_set[hole] = live_set[i];
+        hole = i;
+    }
+    live_set[hole] = NULL;
+}
+
 /* Find header of block, given its payload.
- * Signal error if doesn't seem like legitimate block
+ * Signal error if doesn't seem like legitimate block.
+ * Return NULL if cautious mode proves it is not a live block.
  */
 static block_ele_t *find_header(void *p)
 {
@@ -80,17 +206,12 @@ static block_ele_t *find_header(void *p)
     block_ele_t *b = (block_ele_t *) ((size_t) p - sizeof(block_ele_t));
     if (cautious_mode) {
         /* Make sure this is really an allocated block */
-        block_ele_t *ab = allocated;
-        bool found = false;
-        while (ab && !found) {
-            found = ab == b;
-            ab = ab->next;
-        }
-        if (!found) {
+        if (!live_contains(b)) {
             report_event(MSG_ERROR,
                          "Attempted to free unallocated block.  Address = %p",
                          p);
             error_occurred = true;
+            return NULL;
         }
     }
 
@@ -105,6 +226,56 @@ static block_ele_t *find_header(void *p)
     return b;
 }
 
+/* Size class of a block with given payload size, or -1 if too large */
+static int slab_class(size_t payload_size)
+{
+    size_t bytes = payload_size + sizeof(block_ele_t) + sizeof(size_t);
+    if (bytes > SLAB_MAX_BLOCK)
+        return -1;
+    return (bytes + SLAB_ALIGN - 1) / SLAB_ALIGN - 1;
+}
+
+/* Get storage for a block with given payload size */
+static block_ele_t *slab_alloc(size_t payload_size)
+{
+    int c = slab_class(payload_size);
+    if (c < 0)
+        return malloc(payload_size + sizeof(block_ele_t) + sizeof(size_t));
+
+    block_ele_t *b = slab_free[c];
+    if (b) {
+        slab_free[c] = b->next;
+        return b;
+    }
+
+    size_t bytes = (size_t) (c + 1) * SLAB_ALIGN;
+    if (slab_cur + bytes > slab_end) {
+        /* Leftover of the old chunk is abandoned */
+        unsigned char *chunk = malloc(SLAB_CHUNK);
+        if (!chunk)
+            return NULL;
+        *(void **) chunk = slab_chunks;
+        slab_chunks = chunk;
+        slab_cur = chunk + SLAB_ALIGN;
+        slab_end = chunk + SLAB_CHUNK;
+    }
+    b = (block_ele_t *) slab_cur;
+    slab_cur += bytes;
+    return b;
+}
+
+/* Return storage of a block back to its size class */
+static void slab_release(block_ele_t *b)
+{
+    int c = slab_class(b->payload_size);
+    if (c < 0) {
+        free(b);
+        return;
+    }
+    b->next = slab_free[c];
+    slab_free[c] = b;
+}
+
 /* Given pointer to block, find its footer */
 static size_t *find_footer(block_ele_t *b)
 {
@@ -127,9 +298,9 @@ void *test_malloc(size_t size)
         return NULL;
     }
 
-    block_ele_t *new_block =
-        malloc(size + sizeof(block_ele_t) + sizeof(size_t));
-    if (!new_block) {
+    heap_acquire();
+    block_ele_t *new_block = slab_alloc(size);
+    if (!new_block || !live_insert(new_block)) {
         report_event(MSG_FATAL, "Couldn't allocate any more memory");
         error_occurred = true;
     }
@@ -150,6 +321,7 @@ void *test_malloc(size_t size)
         allocated->prev = new_block;
     allocated = new_block;
     allocated_count++;
+    heap_release();
 
     return p;
 }
@@ -176,7 +348,12 @@ void test_free(void *p)
     if (!p)
         return;
 
+    heap_acquire();
     block_ele_t *b = find_header(p);
+    if (!b) {
+        heap_release();
+        return;
+    }
     size_t footer = *find_footer(b);
     if (footer != MAGICFOOTER) {
         report_event(MSG_ERROR,
@@ -198,9 +375,11 @@ void test_free(void *p)
         allocated = bn;
     if (bn)
         bn->prev = bp;
+    live_remove(b);
 
-    free(b);
+    slab_release(b);
     allocated_count--;
+    heap_release();
 }
 
 // cppcheck-suppress unusedFunction
@@ -253,6 +432,9 @@ bool exception_setup(bool limit_time)
     if (sigsetjmp(env, 1)) {
         /* Got here from longjmp */
         jmp_ready = false;
+        /* The signal may have hit the allocator holding the lock */
+        if (heap_held)
+            heap_release();
         if (time_limited) {
             alarm(0);
             time_limited = false;
@@ -295,3 +477,14 @@ void trigger_exception(char *msg)
     else
         exit(1);
 }
+
+void block_async_signals(sigset_t *old)
+{
+    static const int faults[] = {SIGSEGV, SIGBUS, SIGFPE,  SIGILL,
+                                 SIGTRAP, SIGSYS, SIGABRT};
+    sigset_t set;
+    sigfillset(&set);
+    for (size_t i = 0; i < sizeof(faults) / sizeof(faults[0]); i++)
+        sigdelset(&set, faults[i]);
+    pthread_sigmask(SIG_BLOCK, &set, old);
+}
@@ -2,6 +2,7 @@
 #define LAB0_HARNESS_H
 
 #include <setjmp.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 
@@ -51,6 +52,12 @@ void exception_cancel();
  */
 void trigger_exception(char *msg);
 
+/* Block the signals meant for the thread running the commands, such as the
+ * alarm of the time limit, but none reporting a fault of the thread itself.
+ * Threads created meanwhile inherit the mask.
+ */
+void block_async_signals(sigset_t *old);
+
 #else /* !INTERNAL */
 
 /* Tested program use our versions of malloc and free */
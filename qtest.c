@@ -32,6 +32,8 @@
  */
 #include "queue.h"
 
+#include "concurrent/forkjoin.h"
+#include "concurrent/stress.h"
 #include "console.h"
 #include "report.h"
 
@@ -41,7 +43,6 @@
 
 /* How large is a queue before it's considered big.
  * This affects how it gets printed
- * and whether cautious mode is used when freeing the queue
  */
 #define BIG_LIST 30
 static int big_list_size = BIG_LIST;
@@ -50,9 +51,8 @@ static int big_list_size = BIG_LIST;
 
 /* List being tested */
 typedef struct {
+    /* head returned by q_new(); its size lives in the queue context */
     struct list_head *l;
-    /* meta data of list */
-    int size;
 } list_head_meta_t;
 
 static list_head_meta_t l_meta;
@@ -66,6 +66,62 @@ static int fail_count = 0;
 
 static int string_length = MAXSTRING;
 
+/* Seed of the shuffle generator, only used once set by option */
+static int shuffle_seed = 0;
+
+/* Threads of the fork-join pool, used by parallel sort among others */
+static int sort_threads = 1;
+
+static void sort_parallel(struct list_head *head)
+{
+    q_sort_parallel(head, sort_threads);
+}
+
+/* Sort implementations selectable by the 'sort' option */
+static void (*const sort_funcs[])(struct list_head *) = {
+    q_sort,
+    q_sort_topdown,
+    q_sort_radix,
+    sort_parallel,
+    q_sort_adaptive,
+};
+#define SORT_FUNCS (int) (sizeof(sort_funcs) / sizeof(sort_funcs[0]))
+static int sort_algo = 0;
+
+/* Queues longer than this many elements are sorted by external sort */
+static int ext_budget = 0;
+
+/* Capacity of the queues 'new ring' creates, unless given */
+#define RING_DEFAULT_CAPACITY (1 << 20)
+static int ring_capacity = RING_DEFAULT_CAPACITY;
+
+static struct list_head *new_ring()
+{
+    return q_new_ring(ring_capacity);
+}
+
+/* Rings measured in simulation mode, whatever capacity 'new ring' was given:
+ * big enough that no measured insertion finds them full, and no bigger
+ */
+static struct list_head *new_dut_ring()
+{
+    return q_new_ring(DUT_MAX_LEN);
+}
+
+/* Kinds of queue 'new' can create, the one it creates by default first */
+static const struct {
+    const char *name;
+    struct list_head *(*create)();
+    bool sized; /* takes a capacity */
+} queue_kinds[] = {
+    {NULL, q_new, false},
+    {"arena", q_new_arena, false},
+    {"unrolled", q_new_unrolled, false},
+    {"ring", new_ring, true},
+    {"pool", q_new_pool, false},
+};
+#define QUEUE_KINDS (int) (sizeof(queue_kinds) / sizeof(queue_kinds[0]))
+
 #define MIN_RANDSTR_LEN 5
 #define MAX_RANDSTR_LEN 10
 static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
@@ -85,14 +141,10 @@ static bool do_free(int argc, char *argv[])
         report(3, "Warning: Calling free on null queue");
     error_check();
 
-    if (lcnt > big_list_size)
-        set_cautious_mode(false);
     if (exception_setup(true))
         q_free(l_meta.l);
     exception_cancel();
-    set_cautious_mode(true);
 
-    l_meta.size = 0;
     l_meta.l = NULL;
     lcnt = 0;
     show_queue(3);
@@ -109,23 +161,50 @@ static bool do_free(int argc, char *argv[])
 
 static bool do_new(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    if (argc > 3) {
+        report(1, "%s takes 0-2 arguments", argv[0]);
         return false;
     }
 
+    int kind = 0;
+    if (argc >= 2) {
+        for (kind = 1; kind < QUEUE_KINDS; kind++) {
+            if (!strcmp(argv[1], queue_kinds[kind].name))
+                break;
+        }
+        if (kind == QUEUE_KINDS) {
+            report(1, "Unknown queue kind '%s'", argv[1]);
+            return false;
+        }
+    }
+    if (argc == 3) {
+        if (!queue_kinds[kind].sized) {
+            report(1, "Queue kind '%s' takes no capacity", argv[1]);
+            return false;
+        }
+        if (!get_int(argv[2], &ring_capacity) || ring_capacity <= 0 ||
+            (unsigned int) ring_capacity > RING_MAX_CAPACITY) {
+            report(1, "Invalid capacity '%s'", argv[2]);
+            ring_capacity = RING_DEFAULT_CAPACITY;
+            return false;
+        }
+    } else {
+        ring_capacity = RING_DEFAULT_CAPACITY;
+    }
+
     bool ok = true;
     if (l_meta.l) {
         report(3, "Freeing old queue");
-        ok = do_free(argc, argv);
+        ok = do_free(1, argv);
     }
     error_check();
 
-    if (exception_setup(true)) {
-        l_meta.l = q_new();
-        l_meta.size = 0;
-    }
+    if (exception_setup(true))
+        l_meta.l = queue_kinds[kind].create();
     exception_cancel();
+    /* Simulation mode measures queues of this kind from now on */
+    dut_queue_new =
+        queue_kinds[kind].sized ? new_dut_ring : queue_kinds[kind].create;
     lcnt = 0;
     show_queue(3);
 
@@ -196,9 +275,8 @@ static bool do_ih(int argc, char *argv[])
             bool rval = q_insert_head(l_meta.l, inserts);
             if (rval) {
                 lcnt++;
-                l_meta.size++;
-                char *cur_inserts =
-                    list_entry(l_meta.l->next, element_t, list)->value;
+                q_iter_t it;
+                char *cur_inserts = q_iter_first(&it, l_meta.l)->value;
                 if (!cur_inserts) {
                     report(1, "ERROR: Failed to save copy of string in queue");
                     ok = false;
@@ -285,9 +363,7 @@ static bool do_it(int argc, char *argv[])
             bool rval = q_insert_tail(l_meta.l, inserts);
             if (rval) {
                 lcnt++;
-                l_meta.size++;
-                char *cur_inserts =
-                    list_entry(l_meta.l->prev, element_t, list)->value;
+                char *cur_inserts = q_peek_tail(l_meta.l)->value;
                 if (!cur_inserts) {
                     report(1, "ERROR: Failed to save copy of string in queue");
                     ok = false;
@@ -366,7 +442,7 @@ static bool do_remove(int option, int argc, char *argv[])
     memset(removes + 1, 'X', string_length + STRINGPAD - 1);
     removes[string_length + STRINGPAD] = '\0';
 
-    if (!l_meta.size)
+    if (!q_size(l_meta.l))
         report(3, "Warning: Calling remove head on empty queue");
     error_check();
 
@@ -404,7 +480,6 @@ static bool do_remove(int option, int argc, char *argv[])
             report(2, "Removed %s from queue", removes);
         }
         lcnt--;
-        l_meta.size--;
     } else {
         fail_count++;
         if (!check && fail_count < fail_limit) {
@@ -448,7 +523,7 @@ static bool do_rhq(int argc, char *argv[])
     }
 
     bool ok = true;
-    if (!l_meta.size)
+    if (!q_size(l_meta.l))
         report(3, "Warning: Calling remove head on empty queue");
     error_check();
 
@@ -465,7 +540,6 @@ static bool do_rhq(int argc, char *argv[])
 
         report(2, "Removed element from queue");
         lcnt--;
-        l_meta.size--;
     } else {
         fail_count++;
         if (fail_count < fail_limit)
@@ -480,6 +554,72 @@ static bool do_rhq(int argc, char *argv[])
     return ok && !error_check();
 }
 
+/* Fewest elements a checker hands to a task of its own */
+#define CHECK_GRAIN 4096
+
+/* Elements of the queue in order, in an array for checking in parallel */
+static element_t **gather(struct list_head *head, int *cnt)
+{
+    *cnt = q_size(head);
+    element_t **ele = malloc((*cnt ? *cnt : 1) * sizeof(element_t *));
+    if (!ele)
+        return NULL;
+    q_iter_t it;
+    int i = 0;
+    for (element_t *e = q_iter_first(&it, head); e && i < *cnt;
+         e = q_iter_next(&it))
+        ele[i++] = e;
+    *cnt = i;
+    return ele;
+}
+
+/* State of the parallel part of do_dedup */
+struct dedup_check {
+    char **old;           /* strings before, in order */
+    element_t **now;      /* elements after, in order */
+    element_t **src;      /* elements to copy the strings of */
+    bool *dup;            /* whether old[i] occurs more than once */
+    int *pos;             /* where old[i] should be in now */
+    int cnt;              /* strings in old */
+    atomic_bool mismatch; /* some string is missing or out of place */
+};
+
+static void dedup_copy(size_t lo, size_t hi, void *arg)
+{
+    struct dedup_check *c = arg;
+    for (size_t i = lo; i < hi; i++)
+        c->old[i] = strdup(c->src[i]->value);
+}
+
+static void dedup_mark(size_t lo, size_t hi, void *arg)
+{
+    struct dedup_check *c = arg;
+    for (size_t i = lo; i < hi; i++) {
+        c->dup[i] = (i > 0 && !strcmp(c->old[i - 1], c->old[i])) ||
+                    (i + 1 < c->cnt && !strcmp(c->old[i], c->old[i + 1]));
+    }
+}
+
+static void dedup_compare(size_t lo, size_t hi, void *arg)
+{
+    struct dedup_check *c = arg;
+    for (size_t i = lo; i < hi; i++) {
+        if (!c->dup[i] && strcmp(c->now[c->pos[i]]->value, c->old[i]))
+            atomic_store(&c->mismatch, true);
+    }
+}
+
+static void dedup_check_free(struct dedup_check *c)
+{
+    for (int i = 0; c->old && i < c->cnt; i++)
+        free(c->old[i]);
+    free(c->old);
+    free(c->now);
+    free(c->src);
+    free(c->dup);
+    free(c->pos);
+}
+
 static bool do_dedup(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -487,37 +627,25 @@ static bool do_dedup(int argc, char *argv[])
         return false;
     }
 
-    LIST_HEAD(l_copy);
-    element_t *item = NULL, *tmp = NULL;
-
-    // Copy l_meta.l to l_copy
-    if (l_meta.l && !list_empty(l_meta.l)) {
-        list_for_each_entry (item, l_meta.l, list) {
-            size_t slen;
-            tmp = malloc(sizeof(element_t));
-            if (!tmp)
-                break;
-            INIT_LIST_HEAD(&tmp->list);
-            slen = strlen(item->value) + 1;
-            tmp->value = malloc(slen);
-            if (!tmp->value) {
-                free(tmp);
-                break;
-            }
-            memcpy(tmp->value, item->value, slen);
-            list_add_tail(&tmp->list, &l_copy);
-        }
-        // Return false if the loop does not leave properly
-        if (&item->list != l_meta.l) {
-            list_for_each_entry_safe (item, tmp, &l_copy, list) {
-                free(item->value);
-                free(item);
-            }
-            report(1,
-                   "INTERNAL ERROR.  Could not allocate space for "
-                   "duplicate checking");
-            return false;
-        }
+    /* Copy the strings, on the fork-join pool for long queues */
+    struct dedup_check c = {0};
+    atomic_init(&c.mismatch, false);
+    c.src = gather(l_meta.l, &c.cnt);
+    c.old = c.src ? calloc(c.cnt ? c.cnt : 1, sizeof(char *)) : NULL;
+    bool copied = c.old;
+    if (copied) {
+        fj_parallel_for(c.cnt, CHECK_GRAIN, dedup_copy, &c);
+        for (int i = 0; i < c.cnt; i++)
+            copied = copied && c.old[i];
+    }
+    free(c.src);
+    c.src = NULL;
+    if (!copied) {
+        dedup_check_free(&c);
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for "
+               "duplicate checking");
+        return false;
     }
 
     bool ok = true;
@@ -526,47 +654,138 @@ static bool do_dedup(int argc, char *argv[])
     exception_cancel();
 
     if (!ok) {
-        list_for_each_entry_safe (item, tmp, &l_copy, list) {
-            free(item->value);
-            free(item);
-        }
+        dedup_check_free(&c);
         report(1, "ERROR: Calling delete duplicate on null queue");
         return false;
     }
 
-    struct list_head *l_tmp = l_meta.l->next;
-    bool is_this_dup = false;
-    // Compare between new list and old one
-    list_for_each_entry (item, &l_copy, list) {
-        // Skip comparison with new list if the string is duplicate
-        bool is_next_dup =
-            item->list.next != &l_copy &&
-            strcmp(list_entry(item->list.next, element_t, list)->value,
-                   item->value) == 0;
-        if (is_this_dup || is_next_dup) {
-            // Update list size
+    /* Each string occurring once must be left, in the same order, and no
+     * other string
+     */
+    int left = 0;
+    c.now = gather(l_meta.l, &left);
+    c.dup = malloc((c.cnt ? c.cnt : 1) * sizeof(bool));
+    c.pos = malloc((c.cnt ? c.cnt : 1) * sizeof(int));
+    if (!c.now || !c.dup || !c.pos) {
+        dedup_check_free(&c);
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for "
+               "duplicate checking");
+        return false;
+    }
+    fj_parallel_for(c.cnt, CHECK_GRAIN, dedup_mark, &c);
+    int kept = 0;
+    for (int i = 0; i < c.cnt; i++) {
+        if (c.dup[i])
             lcnt--;
-            l_meta.size--;
-        } else if (l_tmp != l_meta.l &&
-                   strcmp(list_entry(l_tmp, element_t, list)->value,
-                          item->value) == 0)
-            l_tmp = l_tmp->next;
         else
-            ok = false;
-        is_this_dup = is_next_dup;
+            c.pos[i] = kept++;
     }
-    // All elements in new list should be traversed
-    ok = ok && l_tmp == l_meta.l;
+    ok = kept == left;
+    if (ok)
+        fj_parallel_for(c.cnt, CHECK_GRAIN, dedup_compare, &c);
+    ok = ok && !atomic_load(&c.mismatch);
     if (!ok)
         report(1,
                "ERROR: Duplicate strings are in queue or distinct strings are "
                "not in queue");
 
-    list_for_each_entry_safe (item, tmp, &l_copy, list) {
-        free(item->value);
-        free(item);
+    dedup_check_free(&c);
+    show_queue(3);
+    return ok && !error_check();
+}
+
+/* Element of a queue and its position, as seen by do_hdedup */
+typedef struct {
+    element_t *e;
+    int pos;
+} pos_ele_t;
+
+static int cmp_pos_ele(const void *a, const void *b)
+{
+    const pos_ele_t *x = a, *y = b;
+    int c = strcmp(x->e->value, y->e->value);
+    return c ? c : x->pos - y->pos;
+}
+
+static bool do_hdedup(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    /* Work out which elements have to survive, in queue order, before the
+     * duplicates are gone. Sorting the positions by string puts duplicates
+     * next to each other.
+     */
+    int cnt = q_size(l_meta.l);
+    pos_ele_t *byval = NULL;
+    element_t **keep = NULL;
+    if (cnt) {
+        byval = malloc(cnt * sizeof(*byval));
+        keep = malloc(cnt * sizeof(*keep));
+        if (!byval || !keep) {
+            free(byval);
+            free(keep);
+            report(1,
+                   "INTERNAL ERROR.  Could not allocate space for duplicate "
+                   "checking");
+            return false;
+        }
+        int i = 0;
+        q_iter_t it;
+        for (element_t *item = q_iter_first(&it, l_meta.l); item;
+             item = q_iter_next(&it)) {
+            byval[i].e = item;
+            byval[i].pos = i;
+            i++;
+        }
+        qsort(byval, cnt, sizeof(*byval), cmp_pos_ele);
+        memset(keep, 0, cnt * sizeof(*keep));
+        for (i = 0; i < cnt; i++) {
+            bool dup =
+                (i > 0 && !strcmp(byval[i - 1].e->value, byval[i].e->value)) ||
+                (i + 1 < cnt &&
+                 !strcmp(byval[i + 1].e->value, byval[i].e->value));
+            if (!dup)
+                keep[byval[i].pos] = byval[i].e;
+        }
+        free(byval);
+    }
+
+    bool ok = true;
+    if (exception_setup(true))
+        ok = q_delete_dup_hash(l_meta.l);
+    exception_cancel();
+
+    if (!ok) {
+        free(keep);
+        report(1, "ERROR: Calling delete duplicate on null queue or could "
+                  "not allocate its table");
+        return false;
     }
 
+    /* Survivors have to be the very same elements, in their old order */
+    q_iter_t it;
+    element_t *cur = q_iter_first(&it, l_meta.l);
+    for (int i = 0; i < cnt; i++) {
+        if (!keep[i]) {
+            lcnt--;
+            continue;
+        }
+        if (cur != keep[i])
+            ok = false;
+        else
+            cur = q_iter_next(&it);
+    }
+    ok = ok && !cur;
+    if (!ok)
+        report(1,
+               "ERROR: Duplicate strings are in queue or distinct strings are "
+               "not in queue in their original order");
+    free(keep);
+
     show_queue(3);
     return ok && !error_check();
 }
@@ -641,6 +860,23 @@ static bool do_size(int argc, char *argv[])
     return ok && !error_check();
 }
 
+/* State of the parallel part of do_sort */
+struct sort_check {
+    element_t **ele;
+    atomic_bool unsorted;
+};
+
+static void sort_check_pairs(size_t lo, size_t hi, void *arg)
+{
+    struct sort_check *c = arg;
+    for (size_t i = lo; i < hi; i++) {
+        if (strcasecmp(c->ele[i]->value, c->ele[i + 1]->value) > 0) {
+            atomic_store(&c->unsorted, true);
+            return;
+        }
+    }
+}
+
 bool do_sort(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -657,28 +893,124 @@ bool do_sort(int argc, char *argv[])
         report(3, "Warning: Calling sort on single node");
     error_check();
 
-    set_noallocate_mode(true);
+    bool ok = true;
+    if (ext_budget > 0 && cnt > ext_budget) {
+        /* Disk I/O is not bound by the usual time limit */
+        if (exception_setup(false))
+            ok = q_sort_external(l_meta.l, ext_budget);
+        exception_cancel();
+        if (!ok) {
+            report(1, "ERROR: External sort failed");
+            /* Strings that could not be read back are gone */
+            lcnt = q_size(l_meta.l);
+        }
+    } else {
+        set_noallocate_mode(true);
+        if (exception_setup(true))
+            sort_funcs[sort_algo](l_meta.l);
+        exception_cancel();
+        set_noallocate_mode(false);
+    }
+
+    if (q_size(l_meta.l)) {
+        /* Ensure each element in ascending order */
+        /* FIXME: add an option to specify sorting order */
+        struct sort_check c;
+        int n;
+        c.ele = gather(l_meta.l, &n);
+        if (!c.ele) {
+            report(1, "INTERNAL ERROR.  Could not allocate space for checking");
+            return false;
+        }
+        atomic_init(&c.unsorted, false);
+        if (n > cnt)
+            n = cnt;
+        if (n > 1)
+            fj_parallel_for(n - 1, CHECK_GRAIN, sort_check_pairs, &c);
+        free(c.ele);
+        if (atomic_load(&c.unsorted)) {
+            report(1, "ERROR: Not sorted in ascending order");
+            ok = false;
+        }
+    }
+
+    show_queue(3);
+    return ok && !error_check();
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static bool do_sortu(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!l_meta.l)
+        report(3, "Warning: Calling sort on null queue");
+    error_check();
+
+    /* Expected result: the sorted copies of strings occurring just once */
+    int cnt = q_size(l_meta.l), i = 0;
+    char **want = cnt ? malloc(cnt * sizeof(*want)) : NULL;
+    if (cnt && !want) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for checking");
+        return false;
+    }
+    q_iter_t it;
+    if (cnt) {
+        for (element_t *item = q_iter_first(&it, l_meta.l); item;
+             item = q_iter_next(&it)) {
+            want[i] = strdup(item->value);
+            if (!want[i])
+                break;
+            i++;
+        }
+        if (i < cnt) {
+            while (i > 0)
+                free(want[--i]);
+            free(want);
+            report(1,
+                   "INTERNAL ERROR.  Could not allocate space for checking");
+            return false;
+        }
+        qsort(want, cnt, sizeof(*want), cmp_str);
+    }
+
+    bool ok = true;
     if (exception_setup(true))
-        q_sort(l_meta.l);
+        ok = q_sort_unique(l_meta.l);
     exception_cancel();
-    set_noallocate_mode(false);
 
-    bool ok = true;
-    if (l_meta.size) {
-        for (struct list_head *cur_l = l_meta.l->next;
-             cur_l != l_meta.l && --cnt; cur_l = cur_l->next) {
-            /* Ensure each element in ascending order */
-            /* FIXME: add an option to specify sorting order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
-            if (strcasecmp(item->value, next_item->value) > 0) {
-                report(1, "ERROR: Not sorted in ascending order");
-                ok = false;
-                break;
-            }
+    if (!ok)
+        report(1, "ERROR: Calling sort unique on null queue");
+
+    element_t *cur = q_iter_first(&it, l_meta.l);
+    for (i = 0; ok && i < cnt; i++) {
+        bool dup = (i > 0 && !strcmp(want[i - 1], want[i])) ||
+                   (i + 1 < cnt && !strcmp(want[i + 1], want[i]));
+        if (dup) {
+            lcnt--;
+        } else if (cur && !strcmp(cur->value, want[i])) {
+            cur = q_iter_next(&it);
+        } else {
+            report(1,
+                   "ERROR: Queue is not sorted or holds duplicate or missing "
+                   "strings");
+            ok = false;
         }
     }
+    if (ok && cur) {
+        report(1, "ERROR: Queue holds more strings than expected");
+        ok = false;
+    }
+    for (i = 0; i < cnt; i++)
+        free(want[i]);
+    free(want);
 
     show_queue(3);
     return ok && !error_check();
@@ -707,19 +1039,18 @@ bool do_mstd(int argc, char *argv[])
     set_noallocate_mode(false);
 
     bool ok = true;
-    if (l_meta.size) {
-        for (struct list_head *cur_l = l_meta.l->next;
-             cur_l != l_meta.l && --cnt; cur_l = cur_l->next) {
+    if (q_size(l_meta.l)) {
+        q_iter_t it;
+        element_t *item = q_iter_first(&it, l_meta.l), *next_item;
+        while (--cnt && (next_item = q_iter_next(&it))) {
             /* Ensure each element in ascending order */
             /* FIXME: add an option to specify sorting order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
             if (strcasecmp(item->value, next_item->value) > 0) {
                 report(1, "ERROR: Not sorted in ascending order");
                 ok = false;
                 break;
             }
+            item = next_item;
         }
     }
 
@@ -807,16 +1138,16 @@ static bool show_queue(int vlevel)
 
     report_noreturn(vlevel, "l = [");
 
-    struct list_head *ori = l_meta.l;
-    struct list_head *cur = l_meta.l->next;
+    q_iter_t it;
+    element_t *e = NULL;
 
     if (exception_setup(true)) {
-        while (ok && ori != cur && cnt < lcnt) {
-            element_t *e = list_entry(cur, element_t, list);
+        e = q_iter_first(&it, l_meta.l);
+        while (ok && e && cnt < lcnt) {
             if (cnt < big_list_size)
                 report_noreturn(vlevel, cnt == 0 ? "%s" : " %s", e->value);
             cnt++;
-            cur = cur->next;
+            e = q_iter_next(&it);
             ok = ok && !error_check();
         }
     }
@@ -827,7 +1158,7 @@ static bool show_queue(int vlevel)
         return false;
     }
 
-    if (cur == ori) {
+    if (!e) {
         if (cnt <= big_list_size)
             report(vlevel, "]");
         else
@@ -872,9 +1203,266 @@ static bool do_shuffle(int argc, char *argv[])
     return !error_check();
 }
 
+static bool do_mpmc(int argc, char *argv[])
+{
+    if (argc > 4) {
+        report(1, "%s takes 0-3 arguments", argv[0]);
+        return false;
+    }
+
+    /* Producers, consumers, strings per producer */
+    int arg[3] = {4, 4, 100000};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] <= 0) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    /* The queue is its own, the one under test is left alone. No time
+     * limit: the run takes as long as the machine needs for it.
+     */
+    error_check();
+    double ops;
+    bool ok = stress_mpmc(arg[0], arg[1], arg[2], &ops);
+    if (!ok) {
+        report(1,
+               "ERROR: Out of memory or lost, duplicated or reordered "
+               "strings");
+        return false;
+    }
+    report(1, "%d producers, %d consumers: %.0f ops/sec", arg[0], arg[1], ops);
+    return !error_check();
+}
+
+static bool do_spsc(int argc, char *argv[])
+{
+    if (argc > 4) {
+        report(1, "%s takes 0-3 arguments", argv[0]);
+        return false;
+    }
+
+    /* Strings, batch, ring slots */
+    int arg[3] = {1000000, 32, 1024};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] <= 0) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    error_check();
+    double ops, latency;
+    if (!stress_spsc(arg[0], arg[1], arg[2], &ops, &latency)) {
+        report(1, "ERROR: Out of memory or lost or reordered strings");
+        return false;
+    }
+    report(1, "batch %d: %.0f ops/sec, %.0f ns per op, %.0f ns latency",
+           arg[1], ops, 1e9 / ops, latency);
+    return !error_check();
+}
+
+static bool do_tlq(int argc, char *argv[])
+{
+    if (argc > 3) {
+        report(1, "%s takes 0-2 arguments", argv[0]);
+        return false;
+    }
+
+    /* Most threads, strings per thread */
+    int arg[2] = {8, 100000};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] <= 0) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    error_check();
+    for (int t = 1; t <= arg[0]; t++) {
+        double twolock, global;
+        if (!bench_twolock(t, arg[1], &twolock, &global)) {
+            report(1,
+                   "ERROR: Out of memory or lost strings with %d threads",
+                   t);
+            return false;
+        }
+        report(1, "%d threads: two-lock %.0f ops/sec, global lock %.0f ops/sec",
+               t, twolock, global);
+    }
+    return !error_check();
+}
+
+static bool do_bq(int argc, char *argv[])
+{
+    if (argc > 5) {
+        report(1, "%s takes 0-4 arguments", argv[0]);
+        return false;
+    }
+
+    /* Producers, consumers, strings per producer, capacity */
+    int arg[4] = {1, 4, 100000, 0};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] < (i == 4 ? 0 : 1)) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    error_check();
+    double ops, latency;
+    long timeouts;
+    if (!bench_blocking(arg[0], arg[1], arg[2], arg[3], &ops, &latency,
+                        &timeouts)) {
+        report(1,
+               "ERROR: Out of memory or lost, duplicated or reordered "
+               "strings");
+        return false;
+    }
+    report(1,
+           "%d producers, %d consumers: %.0f ops/sec, %.0f ns latency, "
+           "%ld timed waits expired",
+           arg[0], arg[1], ops, latency, timeouts);
+    return !error_check();
+}
+
+static bool do_stack(int argc, char *argv[])
+{
+    if (argc > 3) {
+        report(1, "%s takes 0-2 arguments", argv[0]);
+        return false;
+    }
+
+    /* Most threads, strings per thread */
+    int arg[2] = {8, 100000};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] <= 0) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    error_check();
+    for (int t = 1; t <= arg[0]; t++) {
+        double elim, plain, global;
+        long eliminated;
+        if (!bench_stack(t, arg[1], &elim, &plain, &global, &eliminated)) {
+            report(1,
+                   "ERROR: Out of memory or lost strings with %d threads",
+                   t);
+            return false;
+        }
+        report(1,
+               "%d threads: elimination %.0f ops/sec (%ld eliminated), "
+               "Treiber %.0f ops/sec, global lock %.0f ops/sec",
+               t, elim, eliminated, plain, global);
+    }
+    return !error_check();
+}
+
+static bool do_fc(int argc, char *argv[])
+{
+    if (argc > 3) {
+        report(1, "%s takes 0-2 arguments", argv[0]);
+        return false;
+    }
+
+    /* Threads, calls per thread */
+    int arg[2] = {8, 100000};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] <= 0) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    if (!l_meta.l) {
+        report(1, "ERROR: Calling fc on null queue");
+        return false;
+    }
+    error_check();
+
+    static const char *mode[] = {"mutex per call", "flat combining"};
+    for (int combining = 0; combining <= 1; combining++) {
+        double ops, batch;
+        if (!bench_fc(l_meta.l, arg[0], arg[1], combining, &ops, &batch)) {
+            report(1, "ERROR: Queue size does not add up after %s",
+                   mode[combining]);
+            return false;
+        }
+        report(1, "%s: %.0f ops/sec, %.1f calls per lock", mode[combining],
+               ops, batch);
+    }
+    lcnt = q_size(l_meta.l);
+    show_queue(3);
+    return !error_check();
+}
+
+static bool do_shard(int argc, char *argv[])
+{
+    if (argc > 3) {
+        report(1, "%s takes 0-2 arguments", argv[0]);
+        return false;
+    }
+
+    /* Most threads, calls per thread */
+    int arg[2] = {8, 100000};
+    for (int i = 1; i < argc; i++) {
+        if (!get_int(argv[i], &arg[i - 1]) || arg[i - 1] <= 0) {
+            report(1, "Invalid argument '%s'", argv[i]);
+            return false;
+        }
+    }
+
+    error_check();
+    for (int t = 1; t <= arg[0]; t++) {
+        double sharded, global;
+        long steals;
+        if (!bench_shard(t, arg[1], &sharded, &global, &steals)) {
+            report(1,
+                   "ERROR: Out of memory or lost strings with %d threads",
+                   t);
+            return false;
+        }
+        report(1,
+               "%d threads: sharded %.0f ops/sec (%ld batches stolen), "
+               "global lock %.0f ops/sec",
+               t, sharded, steals, global);
+    }
+    return !error_check();
+}
+
+static void set_threads(int oldval)
+{
+    if (sort_threads < 1) {
+        report(1, "Need at least one thread");
+        sort_threads = oldval;
+    }
+    if (!fj_set_workers(sort_threads))
+        report(1, "Could not start %d threads, running on one", sort_threads);
+}
+
+static void set_shuffle_seed(int oldval)
+{
+    q_shuffle_seed(shuffle_seed);
+}
+
+static void set_sort_algo(int oldval)
+{
+    if (sort_algo < 0 || sort_algo >= SORT_FUNCS) {
+        report(1, "Unknown sort algorithm %d", sort_algo);
+        sort_algo = oldval;
+    }
+}
+
 static void console_init()
 {
-    ADD_COMMAND(new, "                | Create new queue");
+    ADD_COMMAND(new,
+                " [kind [cap]]   | Create new queue.  Kind 'arena' carves its "
+                "elements from a queue-owned arena, 'unrolled' stores them "
+                "in blocks of pointers, 'ring' in a ring buffer of cap "
+                "slots, 'pool' in an array of index-linked nodes.  "
+                "Simulation mode measures the kind last created");
     ADD_COMMAND(free, "                | Delete queue");
     ADD_COMMAND(
         ih,
@@ -897,6 +1485,9 @@ static void console_init()
         "                | Remove from head of queue without reporting value.");
     ADD_COMMAND(reverse, "                | Reverse queue");
     ADD_COMMAND(sort, "                | Sort queue in ascending order");
+    ADD_COMMAND(sortu,
+                "                | Sort queue in ascending order and delete all "
+                "nodes that have duplicate string");
     ADD_COMMAND(mstd,
                 "                | Sort queue in ascending order (Merge Sort "
                 "top-down)");
@@ -906,6 +1497,39 @@ static void console_init()
     ADD_COMMAND(dm, "                | Delete middle node in queue");
     ADD_COMMAND(
         dedup, "                | Delete all nodes that have duplicate string");
+    ADD_COMMAND(hdedup,
+                "                | Delete all nodes that have duplicate string, "
+                "queue needs not be sorted");
+    ADD_COMMAND(mpmc,
+                " [P [C [n]]]    | Stress the lock-free queue with P producers "
+                "inserting n strings each and C consumers, and report "
+                "throughput (default: 4 4 100000)");
+    ADD_COMMAND(spsc,
+                " [n [b [cap]]]  | Stream n strings from one thread to another "
+                "through a ring of cap slots in batches of b, and report "
+                "throughput and latency (default: 1000000 32 1024)");
+    ADD_COMMAND(tlq,
+                " [N [n]]        | Run 1 to N threads inserting and removing n "
+                "strings each on the two-lock queue and on a queue behind one "
+                "mutex, and report throughput (default: 8 100000)");
+    ADD_COMMAND(bq,
+                " [P [C [n [c]]]]| Run P producers inserting n strings each "
+                "and C consumers on the blocking queue holding at most c "
+                "strings, 0 for no limit, and report throughput and latency "
+                "(default: 1 4 100000 0)");
+    ADD_COMMAND(stack,
+                " [N [n]]        | Run 1 to N threads pushing and popping n "
+                "strings each on the lock-free stack with and without "
+                "elimination and on a stack behind one mutex, and report "
+                "throughput (default: 8 100000)");
+    ADD_COMMAND(fc,
+                " [T [n]]        | Share the queue among T threads making n "
+                "calls each, through a mutex per call and then through flat "
+                "combining, and report throughput (default: 8 100000)");
+    ADD_COMMAND(shard,
+                " [N [n]]        | Run 1 to N threads making n unbalanced "
+                "inserts and removes each on the sharded queue and on a queue "
+                "behind one mutex, and report throughput (default: 8 100000)");
     ADD_COMMAND(swap,
                 "                | Swap every two adjacent nodes in queue");
     ADD_COMMAND(shuffle,
@@ -916,6 +1540,22 @@ static void console_init()
               NULL);
     add_param("fail", &fail_limit,
               "Number of times allow queue operations to return false", NULL);
+    add_param("sort", &sort_algo,
+              "Algorithm used by sort: 0 list_sort, 1 top-down merge sort, "
+              "2 MSD radix sort, 3 parallel merge sort, 4 adaptive merge "
+              "sort (Timsort)",
+              set_sort_algo);
+    add_param("extsort", &ext_budget,
+              "Sort queues longer than this many elements by external sort, "
+              "0 to never",
+              NULL);
+    add_param("threads", &sort_threads,
+              "Number of threads of the fork-join pool, used by parallel "
+              "sort, dedup and the checkers",
+              set_threads);
+    add_param("seed", &shuffle_seed,
+              "Seed of shuffle, set it to reproduce the same shuffles",
+              set_shuffle_seed);
 }
 
 /* Signal handlers */
@@ -930,6 +1570,9 @@ static void sigsegvhandler(int sig)
 
 static void sigalrmhandler(int sig)
 {
+    /* Stop a parallel section first, its tasks point into the stack */
+    if (fj_defer_signal(sig))
+        return;
     trigger_exception(
         "Time limit exceeded.  Either you are in an infinite loop, or your "
         "code is too inefficient");
@@ -946,13 +1589,11 @@ static void queue_init()
 static bool queue_quit(int argc, char *argv[])
 {
     report(3, "Freeing queue");
-    if (lcnt > big_list_size)
-        set_cautious_mode(false);
 
     if (exception_setup(true))
         q_free(l_meta.l);
     exception_cancel();
-    set_cautious_mode(true);
+    fj_set_workers(1);
 
     size_t bcnt = allocation_check();
     if (bcnt > 0) {
@@ -1058,6 +1699,7 @@ int main(int argc, char *argv[])
     queue_init();
     init_cmd();
     console_init();
+    set_threads(sort_threads);
 
     /* Initialize linenoise only when infile_name not exist */
     if (!infile_name) {
@@ -1,13 +1,16 @@
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "concurrent/forkjoin.h"
 #include "harness.h"
 #include "queue.h"
+#include "queue_ops.h"
 
-#define structinit(type, name) type *name = (type *) malloc(sizeof(type));
 #define getvalue(node) container_of(node, element_t, list)->value
 
 #ifdef __GNUC__
@@ -23,22 +26,211 @@ typedef int
                                                       const struct list_head *,
                                                       const struct list_head *);
 
+/* Last stage of list_sort: merge two NULL-terminated sorted lists into the
+ * circular list at head
+ */
+typedef void (*list_final_func_t)(void *,
+                                  list_cmp_func_t,
+                                  struct list_head *,
+                                  struct list_head *,
+                                  struct list_head *);
+
 /* Notice: sometimes, Cppcheck would find the potential NULL pointer bugs,
  * but some of them cannot occur. You can suppress them by adding the
  * following line.
  *   cppcheck-suppress nullPointer
  */
 
+/* Bytes requested from the allocator whenever an arena runs out of room */
+#define ARENA_CHUNK (256 * 1024)
+
+/*
+ * One chunk of an arena. Elements are carved from [cur, end) by bumping cur;
+ * chunks filled earlier are kept in the next chain until the queue is freed.
+ */
+struct q_arena {
+    struct q_arena *next;
+    char *cur, *end;
+};
+
 /*
  * Create empty queue.
  * Return NULL if could not allocate space.
  */
+static struct list_head *q_new_list()
+{
+    queue_t *q = malloc(sizeof(queue_t));
+    if (!q)
+        return NULL;
+    INIT_LIST_HEAD(&q->head);
+    q->size = 0;
+    q->mid = NULL;
+    q->arena = NULL;
+    q->ops = NULL;
+    q->store = NULL;
+    q->lent = false;
+    return &q->head;
+}
+
+/*
+ * Create empty queue of the kind selected at build time, a linked list
+ * unless QUEUE_DEFAULT_UNROLLED is defined.
+ * Return NULL if could not allocate space.
+ */
 struct list_head *q_new()
 {
-    struct list_head *plh = malloc(sizeof(struct list_head));
-    if (plh)
-        INIT_LIST_HEAD(plh);
-    return plh;
+#ifdef QUEUE_DEFAULT_UNROLLED
+    return q_new_unrolled();
+#else
+    return q_new_list();
+#endif
+}
+
+/*
+ * Create empty queue storing its elements in an unrolled list.
+ * Return NULL if could not allocate space.
+ */
+struct list_head *q_new_unrolled()
+{
+    struct list_head *head = q_new_list();
+    if (!head)
+        return NULL;
+    queue_t *q = q_ctx(head);
+    if (!unrolled_init(q)) {
+        free(q);
+        return NULL;
+    }
+    q->ops = &unrolled_ops;
+    return head;
+}
+
+/*
+ * Create empty queue whose elements are carved from an arena.
+ * Return NULL if could not allocate space.
+ */
+struct list_head *q_new_arena()
+{
+    struct list_head *head = q_new_list();
+    if (!head)
+        return NULL;
+    struct q_arena *a = malloc(ARENA_CHUNK);
+    if (!a) {
+        free(q_ctx(head));
+        return NULL;
+    }
+    a->next = NULL;
+    a->cur = (char *) (a + 1);
+    a->end = (char *) a + ARENA_CHUNK;
+    q_ctx(head)->arena = a;
+    return head;
+}
+
+/*
+ * Create empty queue storing its elements in a pool of index-linked nodes.
+ * Return NULL if could not allocate space.
+ */
+struct list_head *q_new_pool()
+{
+    struct list_head *head = q_new_list();
+    if (!head)
+        return NULL;
+    queue_t *q = q_ctx(head);
+    if (!pool_init(q)) {
+        free(q);
+        return NULL;
+    }
+    q->ops = &pool_ops;
+    return head;
+}
+
+/*
+ * Create empty queue storing its elements in a ring buffer of at least
+ * capacity slots.
+ * Return NULL if could not allocate space or capacity is too large.
+ */
+struct list_head *q_new_ring(unsigned int capacity)
+{
+    struct list_head *head = q_new_list();
+    if (!head)
+        return NULL;
+    queue_t *q = q_ctx(head);
+    if (!ring_init(q, capacity)) {
+        free(q);
+        return NULL;
+    }
+    q->ops = &ring_ops;
+    return head;
+}
+
+/* Operations of the kind of q, NULL for a linked list or a lent queue */
+static inline const struct q_ops *kind_ops(queue_t *q)
+{
+    return q->lent ? NULL : q->ops;
+}
+
+/*
+ * Link the elements of a queue of another kind into its head, to run the
+ * linked-list code of an operation on it. Return false for a linked list,
+ * which has nothing to lend.
+ */
+static bool lend(struct list_head *head)
+{
+    queue_t *q = q_ctx(head);
+    if (!kind_ops(q))
+        return false;
+    q->ops->lend(q);
+    q->lent = true;
+    return true;
+}
+
+/* Store the elements linked by lend() again */
+static void take_back(struct list_head *head)
+{
+    queue_t *q = q_ctx(head);
+    q->lent = false;
+    q->mid = NULL;
+    q->ops->take_back(q);
+}
+
+/* Does q keep its elements without list nodes, reordering them itself? */
+static inline bool bare(queue_t *q)
+{
+    return kind_ops(q) && !q->ops->lend;
+}
+
+/* Sort a queue without list nodes by the merge sort of its kind, which
+ * stands in for every sorting algorithm. Return false for any other queue.
+ */
+static bool sort_bare(struct list_head *head)
+{
+    queue_t *q = q_ctx(head);
+    if (!bare(q))
+        return false;
+    if (q->size > 1)
+        q->ops->sort(q);
+    return true;
+}
+
+/* Bump-allocate size bytes from the arena of q, growing it by a chunk */
+static void *arena_alloc(queue_t *q, size_t size)
+{
+    struct q_arena *a = q->arena;
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    if (a->cur + size > a->end) {
+        size_t bytes = sizeof(struct q_arena) + size;
+        if (bytes < ARENA_CHUNK)
+            bytes = ARENA_CHUNK;
+        struct q_arena *n = malloc(bytes);
+        if (!n)
+            return NULL;
+        n->next = a;
+        n->cur = (char *) (n + 1);
+        n->end = (char *) n + bytes;
+        q->arena = a = n;
+    }
+    void *p = a->cur;
+    a->cur += size;
+    return p;
 }
 
 /* Free all storage used by queue */
@@ -46,29 +238,92 @@ void q_free(struct list_head *l)
 {
     if (!l)
         return;
-    while (!list_empty(l)) {
-        element_t *tmp = container_of(l->next, element_t, list);
-        list_del(l->next);
-        q_release_element(tmp);
+    queue_t *q = q_ctx(l);
+    if (q->arena) {
+        /* Arena elements go away with their chunks, no need to visit them */
+        while (q->arena) {
+            struct q_arena *a = q->arena;
+            q->arena = a->next;
+            free(a);
+        }
+    } else if (q->ops) {
+        /* The walk only reads the storage, which outlives the elements */
+        q_iter_t it;
+        for (element_t *e = q_iter_first(&it, l); e; e = q_iter_next(&it))
+            q_release_element(e);
+    } else {
+        while (!list_empty(l)) {
+            element_t *tmp = container_of(l->next, element_t, list);
+            list_del(l->next);
+            q_release_element(tmp);
+        }
     }
-    free(l);
+    if (q->ops)
+        q->ops->destroy(q);
+    free(q);
+}
+
+/* Pack the first (up to) 8 bytes of s into a big-endian integer */
+static inline uint64_t key_prefix(const char *s, size_t len)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8 && i < len; i++)
+        key |= (uint64_t) (unsigned char) s[i] << (56 - 8 * i);
+    return key;
+}
+
+/* FNV-1a hash of the len bytes of s */
+static inline uint32_t str_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char) s[i]) * 16777619u;
+    return h;
 }
 
-element_t *new_ele(char *s)
+#define node_cmp(a, b) \
+    ele_cmp(list_entry(a, element_t, list), list_entry(b, element_t, list))
+
+/*
+ * Allocate an element together with a copy of s in one block, from the
+ * arena of q if there is one.
+ * Short strings take the fixed-size fast path so they all land in the same
+ * allocation size; longer ones get exactly what they need. An element of a
+ * queue without list nodes stores its string in place of the list node, the
+ * room of short strings still covering it.
+ */
+static element_t *new_ele(queue_t *q, char *s)
 {
-    structinit(element_t, new);
+    size_t len = strlen(s);
+    size_t room = len < ELE_INLINE_LEN ? ELE_INLINE_LEN : len + 1;
+    size_t head =
+        q && bare(q) ? offsetof(element_t, list) : offsetof(element_t, data);
+    /* Arena chunks are private to the queue, short strings need no rounding */
+    bool arena = q && q->arena;
+    element_t *new =
+        arena ? arena_alloc(q, head + len + 1) : malloc(head + room);
     if (!new)
         return NULL;
-    new->value = malloc(sizeof(char) * (strlen(s) + 1));
-    if (!new->value) {
-        free(new);
-        return NULL;
-    }
-    strncpy(new->value, s, strlen(s));
-    new->value[strlen(s)] = 0;
+    new->value = (char *) new + head;
+    new->key = key_prefix(s, len);
+    new->hash = str_hash(s, len);
+    new->flags = arena ? ELE_ARENA : 0;
+    memcpy(new->value, s, len + 1);
     return new;
 }
 
+element_t *q_new_element(char *s)
+{
+    return s ? new_ele(NULL, s) : NULL;
+}
+
+void q_rekey_element(element_t *e)
+{
+    size_t len = strlen(e->value);
+    e->key = key_prefix(e->value, len);
+    e->hash = str_hash(e->value, len);
+}
+
 /*
  * Attempt to insert element at head of queue.
  * Return true if successful.
@@ -80,10 +335,25 @@ bool q_insert_head(struct list_head *head, char *s)
 {
     if (!(head && s))
         return false;
-    element_t *new = new_ele(s);
+    queue_t *q = q_ctx(head);
+    element_t *new = new_ele(q, s);
     if (!new)
         return false;
+    if (kind_ops(q)) {
+        if (!q->ops->push_head(q, new)) {
+            q_release_element(new);
+            return false;
+        }
+        q->size++;
+        return true;
+    }
     list_add(&new->list, head);
+    /* The middle index n / 2 only grows when n is odd */
+    if (!q->size)
+        q->mid = &new->list;
+    else if (q->mid && !(q->size & 1))
+        q->mid = q->mid->prev;
+    q->size++;
     return true;
 }
 
@@ -98,10 +368,24 @@ bool q_insert_tail(struct list_head *head, char *s)
 {
     if (!(head && s))
         return false;
-    element_t *new = new_ele(s);
+    queue_t *q = q_ctx(head);
+    element_t *new = new_ele(q, s);
     if (!new)
         return false;
+    if (kind_ops(q)) {
+        if (!q->ops->push_tail(q, new)) {
+            q_release_element(new);
+            return false;
+        }
+        q->size++;
+        return true;
+    }
     list_add_tail(&new->list, head);
+    if (!q->size)
+        q->mid = &new->list;
+    else if (q->mid && (q->size & 1))
+        q->mid = q->mid->next;
+    q->size++;
     return true;
 }
 
@@ -121,10 +405,21 @@ bool q_insert_tail(struct list_head *head, char *s)
  */
 element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
 {
-    if (!head || list_empty(head))
+    if (!head || !q_size(head))
         return NULL;
-    element_t *tmp = container_of(head->next, element_t, list);
-    list_del_init(head->next);
+    queue_t *q = q_ctx(head);
+    element_t *tmp;
+    if (kind_ops(q)) {
+        tmp = q->ops->pop_head(q);
+    } else {
+        tmp = container_of(head->next, element_t, list);
+        if (q->size == 1)
+            q->mid = NULL;
+        else if (q->mid && (q->size & 1))
+            q->mid = q->mid->next;
+        list_del_init(head->next);
+    }
+    q->size--;
     if (sp) {
         size_t len = strnlen(tmp->value, bufsize - 1);
         strncpy(sp, tmp->value, len);
@@ -139,10 +434,21 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
 {
-    if (!head || list_empty(head))
+    if (!head || !q_size(head))
         return NULL;
-    element_t *tmp = container_of(head->prev, element_t, list);
-    list_del_init(head->prev);
+    queue_t *q = q_ctx(head);
+    element_t *tmp;
+    if (kind_ops(q)) {
+        tmp = q->ops->pop_tail(q);
+    } else {
+        tmp = container_of(head->prev, element_t, list);
+        if (q->size == 1)
+            q->mid = NULL;
+        else if (q->mid && !(q->size & 1))
+            q->mid = q->mid->prev;
+        list_del_init(head->prev);
+    }
+    q->size--;
     if (sp) {
         size_t len = strnlen(tmp->value, bufsize - 1);
         strncpy(sp, tmp->value, len);
@@ -155,18 +461,64 @@ element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
 /*
  * Return number of elements in queue.
  * Return 0 if q is NULL or empty
+ * The count is maintained by every operation linking or unlinking elements,
+ * so no traversal is needed.
  */
 int q_size(struct list_head *head)
 {
     if (!head)
         return 0;
+    return q_ctx(head)->size;
+}
+
+/*
+ * Point the iterator at the first element of the queue and return it.
+ * Return NULL if queue is NULL or empty.
+ */
+element_t *q_iter_first(q_iter_t *it, struct list_head *head)
+{
+    it->head = head;
+    if (!head)
+        return NULL;
+    queue_t *q = q_ctx(head);
+    if (kind_ops(q))
+        return q->size ? q->ops->first(q, it) : NULL;
+    if (list_empty(head))
+        return NULL;
+    it->pos = head->next;
+    return list_entry(head->next, element_t, list);
+}
 
-    int len = 0;
-    struct list_head *li;
+/*
+ * Step the iterator to the next element and return it.
+ * Return NULL past the tail.
+ */
+element_t *q_iter_next(q_iter_t *it)
+{
+    queue_t *q = q_ctx(it->head);
+    if (kind_ops(q))
+        return q->ops->next(it);
+    struct list_head *next = ((struct list_head *) it->pos)->next;
+    if (next == it->head)
+        return NULL;
+    it->pos = next;
+    return list_entry(next, element_t, list);
+}
 
-    list_for_each (li, head)
-        len++;
-    return len;
+/*
+ * Return the last element of the queue.
+ * Return NULL if queue is NULL or empty.
+ */
+element_t *q_peek_tail(struct list_head *head)
+{
+    if (!head)
+        return NULL;
+    queue_t *q = q_ctx(head);
+    if (kind_ops(q))
+        return q->size ? q->ops->last(q) : NULL;
+    if (list_empty(head))
+        return NULL;
+    return list_entry(head->prev, element_t, list);
 }
 
 /*
@@ -176,23 +528,80 @@ int q_size(struct list_head *head)
  * If there're six element, the third member should be return.
  * Return true if successful.
  * Return false if list is NULL or empty.
+ * The middle node is tracked by every insertion and removal at either end,
+ * it is only searched for after an operation reordered the queue.
  */
 bool q_delete_mid(struct list_head *head)
 {
     // https://leetcode.com/problems/delete-the-middle-node-of-a-linked-list/
-    if (!head || list_empty(head))
+    if (!head || !q_size(head))
         return false;
-    struct list_head *h = head->next;
-    struct list_head *t = head->prev;
-    while (!(h == t || h->next == t)) {
-        h = h->next;
-        t = t->prev;
+    queue_t *q = q_ctx(head);
+    if (kind_ops(q)) {
+        element_t *e = q->ops->pop_at(q, q->size / 2);
+        q->size--;
+        q_release_element(e);
+        return true;
+    }
+    struct list_head *t = q->mid;
+    if (!t) {
+        struct list_head *h = head->next;
+        t = head->prev;
+        while (!(h == t || h->next == t)) {
+            h = h->next;
+            t = t->prev;
+        }
     }
+    /* Node n / 2 goes, the new middle (n - 1) / 2 is next to it */
+    if (q->size == 1)
+        q->mid = NULL;
+    else
+        q->mid = q->size & 1 ? t->next : t->prev;
     list_del(t);
+    q->size--;
     q_release_element(list_entry(t, element_t, list));
     return true;
 }
 
+/* Flag the elements of a sorted queue whose string the next or the previous
+ * element holds as well
+ */
+static void flag_sorted_dup(struct list_head *head)
+{
+    q_iter_t it;
+    element_t *prev = q_iter_first(&it, head);
+    if (!prev)
+        return;
+    for (element_t *e; (e = q_iter_next(&it)); prev = e) {
+        if (!ele_cmp(prev, e)) {
+            prev->flags |= ELE_DUP;
+            e->flags |= ELE_DUP;
+        }
+    }
+}
+
+/* Delete the elements flagged ELE_DUP from a queue of another kind. The
+ * others move forward in place, then the slots left over at the tail go.
+ */
+static void drop_dup(queue_t *q)
+{
+    q_iter_t rd, wr;
+    int kept = 0;
+    q_iter_first(&wr, &q->head);
+    for (element_t *e = q_iter_first(&rd, &q->head); e;
+         e = q_iter_next(&rd)) {
+        if (e->flags & ELE_DUP) {
+            q_release_element(e);
+            continue;
+        }
+        q->ops->set(&wr, e);
+        q_iter_next(&wr);
+        kept++;
+    }
+    for (; q->size > kept; q->size--)
+        q->ops->pop_tail(q);
+}
+
 /*
  * Delete all nodes that have duplicate string,
  * leaving only distinct strings from the original list.
@@ -207,7 +616,14 @@ bool q_delete_dup(struct list_head *head)
     // https://leetcode.com/problems/remove-duplicates-from-sorted-list-ii/
     if (!head)
         return false;
+    queue_t *q = q_ctx(head);
+    if (kind_ops(q)) {
+        flag_sorted_dup(head);
+        drop_dup(q);
+        return true;
+    }
 
+    q->mid = NULL;
     LIST_HEAD(dup_l);
     bool prev = false;
     element_t *ptr = list_entry(head->next, element_t, list);
@@ -215,7 +631,7 @@ bool q_delete_dup(struct list_head *head)
 
     for (bool is_dup = false; next->list.next != head; ptr = next) {
         next = list_entry(ptr->list.next, element_t, list);
-        is_dup = !strncmp(ptr->value, next->value, strlen(ptr->value));
+        is_dup = !strcmp(ptr->value, next->value);
         if (is_dup || prev)
             list_move(&ptr->list, &dup_l);
         prev = is_dup;
@@ -225,12 +641,158 @@ bool q_delete_dup(struct list_head *head)
         list_move(&ptr->list, &dup_l);
 
     list_for_each_entry_safe (ptr, next, &dup_l, list) {
-        free(ptr->value);
-        free(ptr);
+        q_release_element(ptr);
+        q->size--;
     }
     return true;
 }
 
+/* Empty table for count entries, kept at most half full */
+static element_t **dedup_table(size_t count, int *bits)
+{
+    *bits = 1;
+    while ((1UL << *bits) < 2UL * count)
+        (*bits)++;
+    element_t **tab = malloc((1UL << *bits) * sizeof(*tab));
+    if (tab)
+        memset(tab, 0, (1UL << *bits) * sizeof(*tab));
+    return tab;
+}
+
+/* Look e up in the table, flag it and the node it matches as duplicates or
+ * add it
+ */
+static inline void dedup_probe(element_t **tab, int bits, element_t *e)
+{
+    size_t mask = (1UL << bits) - 1;
+    /* Fibonacci hashing, the index comes from the well-mixed top bits */
+    size_t i = (uint32_t) (e->hash * 0x9E3779B1u) >> (32 - bits);
+    while (tab[i] && (tab[i]->hash != e->hash || ele_cmp(tab[i], e)))
+        i = (i + 1) & mask;
+    if (tab[i]) {
+        tab[i]->flags |= ELE_DUP;
+        e->flags |= ELE_DUP;
+    } else {
+        tab[i] = e;
+    }
+}
+
+/* Queues shorter than this are hashed by one thread */
+#define DEDUP_MIN_PARALLEL 65536
+
+/* Elements split by hash into parts, each part hashed by a task of its own
+ * into a table of its own. Equal strings have equal hashes, so no match
+ * crosses parts. The elements of part p are ele[start[p]] up to
+ * ele[start[p + 1]].
+ */
+struct dedup_job {
+    element_t **ele;
+    size_t *start;
+    unsigned int parts;
+    atomic_bool failed;
+};
+
+static void dedup_part(size_t lo, size_t hi, void *arg)
+{
+    struct dedup_job *job = arg;
+    for (size_t part = lo; part < hi; part++) {
+        size_t first = job->start[part], last = job->start[part + 1];
+        int bits;
+        element_t **tab = dedup_table(last - first, &bits);
+        if (!tab) {
+            atomic_store(&job->failed, true);
+            return;
+        }
+        for (size_t k = first; k < last; k++)
+            dedup_probe(tab, bits, job->ele[k]);
+        free(tab);
+    }
+}
+
+/* Flag the duplicates on the fork-join pool, false if memory ran out */
+static bool dedup_flag_parallel(struct list_head *head, size_t n)
+{
+    struct dedup_job job = {
+        .ele = malloc(n * sizeof(element_t *)),
+        .parts = fj_workers(),
+    };
+    job.start = malloc((job.parts + 1) * sizeof(size_t));
+    atomic_init(&job.failed, false);
+    if (!job.ele || !job.start) {
+        free(job.ele);
+        free(job.start);
+        return false;
+    }
+    memset(job.start, 0, (job.parts + 1) * sizeof(size_t));
+
+    /* Bucket the elements by part in one counting pass over the queue */
+    q_iter_t it;
+    element_t *e;
+    for (e = q_iter_first(&it, head); e; e = q_iter_next(&it))
+        job.start[e->hash % job.parts + 1]++;
+    for (unsigned int p = 0; p < job.parts; p++)
+        job.start[p + 1] += job.start[p];
+    for (e = q_iter_first(&it, head); e; e = q_iter_next(&it))
+        job.ele[job.start[e->hash % job.parts]++] = e;
+    /* Placing moved each start to the end of its part, shift them back */
+    memmove(job.start + 1, job.start, job.parts * sizeof(size_t));
+    job.start[0] = 0;
+
+    fj_parallel_for(job.parts, 1, dedup_part, &job);
+    free(job.ele);
+    free(job.start);
+    return !atomic_load(&job.failed);
+}
+
+/*
+ * Delete all nodes that have duplicate string, the list may be in any order.
+ * Strings are looked up in an open-addressing table keyed by the hashes
+ * cached in the elements; the first node of every string sits in the table
+ * and gets flagged together with each later node holding the same string.
+ * Long queues are split by hash over the fork-join pool.
+ * A second pass deletes the flagged nodes.
+ * Return false if list is NULL or the table could not be allocated.
+ */
+bool q_delete_dup_hash(struct list_head *head)
+{
+    if (!head)
+        return false;
+    queue_t *q = q_ctx(head);
+    if (q->size < 2)
+        return true;
+
+    q_iter_t it;
+    element_t *e, *safe;
+    /* Flags set before a failure are right all the same, start over */
+    if (q->size < DEDUP_MIN_PARALLEL || fj_workers() < 2 ||
+        !dedup_flag_parallel(head, q->size)) {
+        int bits;
+        element_t **tab = dedup_table(q->size, &bits);
+        if (!tab) {
+            /* Leave no flag behind for a later call to act on */
+            for (e = q_iter_first(&it, head); e; e = q_iter_next(&it))
+                e->flags &= ~ELE_DUP;
+            return false;
+        }
+        for (e = q_iter_first(&it, head); e; e = q_iter_next(&it))
+            dedup_probe(tab, bits, e);
+        free(tab);
+    }
+
+    if (kind_ops(q)) {
+        drop_dup(q);
+        return true;
+    }
+    q->mid = NULL;
+    list_for_each_entry_safe (e, safe, head, list) {
+        if (e->flags & ELE_DUP) {
+            list_del(&e->list);
+            q->size--;
+            q_release_element(e);
+        }
+    }
+    return true;
+}
 
 /*
  * Attempt to swap every two adjacent nodes.
@@ -238,8 +800,22 @@ bool q_delete_dup(struct list_head *head)
 void q_swap(struct list_head *head)
 {
     // https://leetcode.com/problems/swap-nodes-in-pairs/
-    if (!head || (head->next == head->prev))
+    if (!head)
+        return;
+    queue_t *q = q_ctx(head);
+    if (bare(q)) {
+        if (q->size > 1)
+            q->ops->swap(q);
+        return;
+    }
+    if (lend(head)) {
+        q_swap(head);
+        take_back(head);
         return;
+    }
+    if (head->next == head->prev)
+        return;
+    q->mid = NULL;
     struct list_head *left = head->next;
     struct list_head *right = left->next;
 
@@ -274,8 +850,22 @@ static inline void swapptr(char **a, char **b)
  */
 void q_reverse(struct list_head *head)
 {
-    if (!head || list_empty(head))
+    if (!head)
+        return;
+    queue_t *q = q_ctx(head);
+    if (bare(q)) {
+        if (q->size > 1)
+            q->ops->reverse(q);
         return;
+    }
+    if (lend(head)) {
+        q_reverse(head);
+        take_back(head);
+        return;
+    }
+    if (list_empty(head))
+        return;
+    q->mid = NULL;
     struct list_head *p = head;
 
     do {
@@ -301,11 +891,11 @@ struct list_head *merge_two_lists(struct list_head *l1, struct list_head *l2)
         ;
     for (; p2->next; p2 = p2->next)
         ;
-    if (strcmp(getvalue(p1), getvalue(l2)) == 0) {
+    if (node_cmp(p1, l2) == 0) {
         p1->next = l2;
         l2->prev = p1;
         return l1;
-    } else if (strcmp(getvalue(l1), getvalue(p2)) == 0) {
+    } else if (node_cmp(l1, p2) == 0) {
         p2->next = l1;
         l1->prev = p2;
         return l2;
@@ -313,8 +903,7 @@ struct list_head *merge_two_lists(struct list_head *l1, struct list_head *l2)
     struct list_head *ret = NULL;
     struct list_head **tail = &ret;
     while (l1 && l2) {
-        struct list_head **small =
-            strcmp(getvalue(l1), getvalue(l2)) <= 0 ? &l1 : &l2;
+        struct list_head **small = node_cmp(l1, l2) <= 0 ? &l1 : &l2;
         *tail = *small;
         tail = &(*small)->next;
         (*small) = (*small)->next;
@@ -335,9 +924,19 @@ void merge_sort(struct list_head **head)
 
 void q_sort_topdown(struct list_head *head)
 {
-    if (!head || list_is_singular(head) || list_empty(head))
+    if (!head)
+        return;
+    if (sort_bare(head))
+        return;
+    if (lend(head)) {
+        q_sort_topdown(head);
+        take_back(head);
+        return;
+    }
+    if (list_is_singular(head) || list_empty(head))
         return;
 
+    q_ctx(head)->mid = NULL;
     head->prev->next = NULL;
     merge_sort(&head->next);
     struct list_head *prev = head;
@@ -429,9 +1028,70 @@ __attribute__((nonnull(2, 3, 4, 5))) static void merge_final(
     tail->next = head;
     head->prev = tail;
 }
-__attribute__((nonnull(2, 3))) void list_sort(void *priv,
-                                              struct list_head *head,
-                                              list_cmp_func_t cmp)
+/*
+ * Merge two sorted lists into the circular list at head like merge_final,
+ * deleting every node whose string occurs more than once. A node is only
+ * linked once the next one in order is known to differ from it. priv is the
+ * queue context, whose size is kept up to date.
+ */
+__attribute__((nonnull(2, 3, 4, 5))) static void merge_final_unique(
+    void *priv,
+    list_cmp_func_t cmp,
+    struct list_head *head,
+    struct list_head *a,
+    struct list_head *b)
+{
+    queue_t *q = priv;
+    struct list_head *tail = head, *last = NULL;
+    bool dup = false;
+
+    while (a || b) {
+        struct list_head *x;
+        if (!b || (a && cmp(priv, a, b) <= 0)) {
+            x = a;
+            a = a->next;
+        } else {
+            x = b;
+            b = b->next;
+        }
+
+        if (last && !cmp(priv, last, x)) {
+            dup = true;
+            q->size--;
+            q_release_element(list_entry(x, element_t, list));
+            continue;
+        }
+        if (last && dup) {
+            q->size--;
+            q_release_element(list_entry(last, element_t, list));
+        } else if (last) {
+            tail->next = last;
+            last->prev = tail;
+            tail = last;
+        }
+        last = x;
+        dup = false;
+    }
+    if (dup) {
+        q->size--;
+        q_release_element(list_entry(last, element_t, list));
+    } else {
+        tail->next = last;
+        last->prev = tail;
+        tail = last;
+    }
+
+    /* And the final links to make a circular doubly-linked list */
+    tail->next = head;
+    head->prev = tail;
+}
+
+/* list_sort, finishing with the given final merge */
+__attribute__((nonnull(2, 3, 4))) static void list_sort_with(
+    void *priv,
+    struct list_head *head,
+    list_cmp_func_t cmp,
+    list_final_func_t final)
 {
     struct list_head *list = head->next, *pending = NULL;
     size_t count = 0; /* Count of pending */
@@ -497,12 +1157,20 @@ __attribute__((nonnull(2, 3))) void list_sort(void *priv,
         pending = next;
     }
     /* The final merge, rebuilding prev links */
-    merge_final(priv, cmp, head, pending, list);
+    final(priv, cmp, head, pending, list);
+}
+
+__attribute__((nonnull(2, 3))) void list_sort(void *priv,
+                                              struct list_head *head,
+                                              list_cmp_func_t cmp)
+{
+    list_sort_with(priv, head, cmp, merge_final);
 }
 
 int cmpfunc(void *param, const struct list_head *a, const struct list_head *b)
 {
-    return (strcmp(getvalue(a), getvalue(b)) >= 0) ? 1 : -1;
+    /* Equal strings must compare as 0, so merge keeps them in order */
+    return node_cmp(a, b);
 }
 /*
  * Sort elements of queue in ascending order
@@ -511,33 +1179,968 @@ int cmpfunc(void *param, const struct list_head *a, const struct list_head *b)
  */
 void q_sort(struct list_head *head)
 {
-    if (!head || list_is_singular(head) || list_empty(head))
+    if (!head)
+        return;
+    if (sort_bare(head))
+        return;
+    if (lend(head)) {
+        q_sort(head);
+        take_back(head);
         return;
+    }
+    if (list_is_singular(head) || list_empty(head))
+        return;
+    q_ctx(head)->mid = NULL;
     list_sort(NULL, head, cmpfunc);
     return;
 }
 
-int randnumber(int *num)
+/*
+ * Sort elements of queue in ascending order and delete all nodes that have
+ * duplicate string, in one pass: duplicates are dropped by the final merge
+ * of list_sort as it rebuilds the list.
+ * Return false if list is NULL.
+ */
+bool q_sort_unique(struct list_head *head)
 {
-    (*num)--;
-    return rand() % ((*num) + 1) + 1;
+    if (!head)
+        return false;
+    if (sort_bare(head))
+        return q_delete_dup(head);
+    if (lend(head)) {
+        bool ok = q_sort_unique(head);
+        take_back(head);
+        return ok;
+    }
+    if (list_empty(head) || list_is_singular(head))
+        return true;
+    queue_t *q = q_ctx(head);
+    q->mid = NULL;
+    list_sort_with(q, head, cmpfunc, merge_final_unique);
+    return true;
 }
 
-void q_shuffle(struct list_head *head)
+/* Upper bound of segments q_sort_parallel sorts at once */
+#define SORT_MAX_THREADS 64
+
+/* Fewest nodes worth handing to a thread of its own */
+#define SORT_MIN_SEGMENT 8192
+
+/*
+ * Sorting of segments [lo, hi) of the list in q_sort_parallel.
+ * Each segment starts out as a NULL-terminated run of len nodes. When done,
+ * run[lo] holds all of them merged into one sorted NULL-terminated list, or,
+ * if head is set, head is the circular list of them all.
+ */
+struct sort_job {
+    struct list_head **run;
+    size_t *len;
+    int lo, hi;
+    struct list_head *head;
+};
+
+static void sort_job_run(void *arg)
 {
-    struct list_head *p;
-    int iter = q_size(head);
+    struct sort_job *job = arg;
 
-    if (!head || list_is_singular(head) || list_empty(head))
+    if (job->hi - job->lo == 1) {
+        /* Runs left unsorted still merge into one list */
+        if (fj_cancelled())
+            return;
+        /* list_sort wants a circular list, lend it a temporary head */
+        struct list_head tmp, *last = job->run[job->lo];
+        for (size_t i = 1; i < job->len[job->lo]; i++)
+            last = last->next;
+        tmp.next = job->run[job->lo];
+        tmp.prev = last;
+        last->next = &tmp;
+        list_sort(NULL, &tmp, cmpfunc);
+        tmp.prev->next = NULL;
+        job->run[job->lo] = tmp.next;
         return;
-
-    srand(time(NULL));
-    while (iter > 1) {
-        int num = randnumber(&iter);
-        p = head;
-        for (int i = 0; i < num; p = p->next, i++)
-            ;
-        list_move_tail(p, head);
     }
-    return;
+
+    int mid = job->lo + (job->hi - job->lo) / 2;
+    struct sort_job left = {job->run, job->len, job->lo, mid, NULL};
+    struct sort_job right = {job->run, job->len, mid, job->hi, NULL};
+    struct fj_join j = FJ_JOIN_INIT;
+    struct fj_task t;
+    fj_spawn(&j, &t, sort_job_run, &left);
+    sort_job_run(&right);
+    fj_join(&j);
+
+    /* Left run first, so that equal strings stay in order */
+    if (job->head)
+        merge_final(NULL, cmpfunc, job->head, job->run[job->lo],
+                    job->run[mid]);
+    else
+        job->run[job->lo] =
+            merge(NULL, cmpfunc, job->run[job->lo], job->run[mid]);
+}
+
+/*
+ * Sort elements of queue in ascending order in up to nthreads segments.
+ * The list is cut into segments, segments are sorted as tasks of the
+ * fork-join pool by list_sort and merged pairwise as the tasks join, the
+ * last merge rebuilding the circular doubly-linked list.
+ */
+void q_sort_parallel(struct list_head *head, int nthreads)
+{
+    if (!head)
+        return;
+    if (sort_bare(head))
+        return;
+    if (lend(head)) {
+        q_sort_parallel(head, nthreads);
+        take_back(head);
+        return;
+    }
+    if (list_is_singular(head) || list_empty(head))
+        return;
+
+    q_ctx(head)->mid = NULL;
+    size_t n = q_size(head);
+    if (nthreads > SORT_MAX_THREADS)
+        nthreads = SORT_MAX_THREADS;
+    if (nthreads > 0 && (size_t) nthreads > n / SORT_MIN_SEGMENT)
+        nthreads = n / SORT_MIN_SEGMENT;
+    if (nthreads < 2) {
+        q_sort(head);
+        return;
+    }
+
+    struct list_head *run[SORT_MAX_THREADS];
+    size_t len[SORT_MAX_THREADS];
+    struct list_head *node = head->next;
+    head->prev->next = NULL;
+    for (int t = 0; t < nthreads; t++) {
+        len[t] = n / nthreads + ((size_t) t < n % nthreads);
+        run[t] = node;
+        for (size_t i = 1; i < len[t]; i++)
+            node = node->next;
+        struct list_head *next = node->next;
+        node->next = NULL;
+        node = next;
+    }
+
+    /* A SIGALRM arriving meanwhile is held until the list is whole again */
+    struct sort_job job = {run, len, 0, nthreads, head};
+    fj_run(sort_job_run, &job);
+}
+
+/* Consecutive wins of one run before a merge starts galloping through it */
+#define TIM_MIN_GALLOP 7
+
+/* Enough pending runs for any queue size, as run lengths grow like the
+ * Fibonacci sequence from the top of the stack down.
+ */
+#define TIM_MAX_RUNS 64
+
+struct tim_run {
+    struct list_head *list, *tail; /* NULL-terminated */
+    size_t len;
+};
+
+/* Shortest run worth merging for n nodes, between 32 and 64 */
+static size_t tim_minrun(size_t n)
+{
+    size_t r = 0;
+    while (n >= 64) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+/*
+ * Cut the next run off the NULL-terminated *list and advance *list past it.
+ * A run is the longest non-descending stretch, or strictly descending one,
+ * which is reversed on the way. Runs shorter than minrun are extended by
+ * insertion sort. Strictness keeps equal strings in order.
+ */
+static struct list_head *tim_next_run(struct list_head **list,
+                                      size_t minrun,
+                                      size_t *len,
+                                      struct list_head **last)
+{
+    struct list_head *run = *list, *tail = run, *rest = run->next;
+    size_t n = 1;
+
+    if (rest && node_cmp(run, rest) > 0) {
+        tail->next = NULL;
+        while (rest && node_cmp(run, rest) > 0) {
+            struct list_head *next = rest->next;
+            rest->next = run;
+            run = rest;
+            rest = next;
+            n++;
+        }
+    } else {
+        while (rest && node_cmp(tail, rest) <= 0) {
+            tail = rest;
+            rest = rest->next;
+            n++;
+        }
+        tail->next = NULL;
+    }
+
+    for (; n < minrun && rest; n++) {
+        struct list_head *x = rest;
+        rest = rest->next;
+        if (node_cmp(tail, x) <= 0) {
+            tail->next = x;
+            tail = x;
+            x->next = NULL;
+        } else if (node_cmp(run, x) > 0) {
+            x->next = run;
+            run = x;
+        } else {
+            /* Stops before tail at the latest, which sorts after x */
+            struct list_head *p = run;
+            while (node_cmp(p->next, x) <= 0)
+                p = p->next;
+            x->next = p->next;
+            p->next = x;
+        }
+    }
+
+    *list = rest;
+    *len = n;
+    *last = tail;
+    return run;
+}
+
+/* Does x go before y? Nodes equal to y do only if ties is set. */
+static inline bool tim_before(const struct list_head *x,
+                              const struct list_head *y,
+                              bool ties)
+{
+    int c = node_cmp(x, y);
+    return c < 0 || (ties && c == 0);
+}
+
+/*
+ * Return the last node of the run starting at x that goes before y, given
+ * that x itself does. Strides of 1, 2, 4... nodes find a node that does not,
+ * then halving finds the boundary in between, so a stretch of k nodes costs
+ * O(log k) comparisons. A singly-linked run cannot be jumped through, but
+ * each stride notes its middle node, so the halving never walks the stride
+ * again and every node is passed about once.
+ */
+static struct list_head *tim_gallop(struct list_head *x,
+                                    const struct list_head *y,
+                                    bool ties)
+{
+    struct list_head *last = x, *probe, *mid;
+    size_t step = 1, i;
+
+    for (;;) {
+        probe = last;
+        mid = NULL;
+        for (i = 0; i < step && probe->next; i++) {
+            probe = probe->next;
+            if (i + 1 == step / 2)
+                mid = probe;
+        }
+        if (!i)
+            return last;
+        if (!tim_before(probe, y, ties))
+            break;
+        last = probe;
+        step <<= 1;
+    }
+
+    /* last goes first and the node i after it does not */
+    size_t lo = 0, hi = i;
+    if (mid && i == step) {
+        if (tim_before(mid, y, ties)) {
+            last = mid;
+            lo = step / 2;
+        } else {
+            hi = step / 2;
+        }
+    }
+    while (hi - lo > 1) {
+        size_t m = lo + (hi - lo) / 2;
+        probe = last;
+        for (size_t k = lo; k < m; k++)
+            probe = probe->next;
+        if (tim_before(probe, y, ties)) {
+            last = probe;
+            lo = m;
+        } else {
+            hi = m;
+        }
+    }
+    return last;
+}
+
+/*
+ * Merge NULL-terminated sorted runs a and b, a coming first in the queue,
+ * ta and tb being their last nodes; the last node of the result goes to
+ * *tail. Runs that do not overlap are joined in O(1). Otherwise, once one
+ * side wins TIM_MIN_GALLOP times in a row, whole stretches of it are found
+ * by galloping and spliced at once.
+ */
+static struct list_head *tim_merge(struct list_head *a,
+                                   struct list_head *ta,
+                                   struct list_head *b,
+                                   struct list_head *tb,
+                                   struct list_head **tail)
+{
+    /* if equal, 'a' goes first -- important for sort stability */
+    if (node_cmp(ta, b) <= 0) {
+        ta->next = b;
+        *tail = tb;
+        return a;
+    }
+    if (node_cmp(tb, a) < 0) {
+        tb->next = a;
+        *tail = ta;
+        return b;
+    }
+
+    struct list_head *head = NULL, **next = &head;
+    int wins_a = 0, wins_b = 0;
+
+    while (a && b) {
+        struct list_head *last;
+        if (node_cmp(a, b) <= 0) {
+            last = ++wins_a >= TIM_MIN_GALLOP ? tim_gallop(a, b, true) : a;
+            wins_b = 0;
+            *next = a;
+            a = last->next;
+        } else {
+            last = ++wins_b >= TIM_MIN_GALLOP ? tim_gallop(b, a, false) : b;
+            wins_a = 0;
+            *next = b;
+            b = last->next;
+        }
+        next = &last->next;
+    }
+    *next = a ? a : b;
+    *tail = a ? ta : tb;
+    return head;
+}
+
+/* Merge runs i and i + 1 of the n pending ones */
+static void tim_merge_at(struct tim_run *runs, int i, int n)
+{
+    runs[i].list = tim_merge(runs[i].list, runs[i].tail, runs[i + 1].list,
+                             runs[i + 1].tail, &runs[i].tail);
+    runs[i].len += runs[i + 1].len;
+    for (i++; i < n - 1; i++)
+        runs[i] = runs[i + 1];
+}
+
+/*
+ * Merge pending runs until their lengths, from the top of the stack down,
+ * grow faster than the Fibonacci sequence. That keeps merges balanced and
+ * the stack shallow. Return the number of runs left.
+ */
+static int tim_collapse(struct tim_run *runs, int n)
+{
+    while (n > 1) {
+        int i = n - 2;
+        if ((i > 0 && runs[i - 1].len <= runs[i].len + runs[i + 1].len) ||
+            (i > 1 && runs[i - 2].len <= runs[i - 1].len + runs[i].len)) {
+            if (runs[i - 1].len < runs[i + 1].len)
+                i--;
+        } else if (runs[i].len > runs[i + 1].len) {
+            break;
+        }
+        tim_merge_at(runs, i, n--);
+    }
+    return n;
+}
+
+/*
+ * Sort elements of queue in ascending order, adapting to existing order.
+ * No effect if q is NULL or empty. In addition, if q has only one
+ * element, do nothing.
+ */
+void q_sort_adaptive(struct list_head *head)
+{
+    if (!head)
+        return;
+    if (sort_bare(head))
+        return;
+    if (lend(head)) {
+        q_sort_adaptive(head);
+        take_back(head);
+        return;
+    }
+    if (list_is_singular(head) || list_empty(head))
+        return;
+
+    q_ctx(head)->mid = NULL;
+    struct tim_run runs[TIM_MAX_RUNS];
+    int n = 0;
+    size_t minrun = tim_minrun(q_size(head));
+    struct list_head *list = head->next;
+
+    head->prev->next = NULL;
+    while (list) {
+        runs[n].list =
+            tim_next_run(&list, minrun, &runs[n].len, &runs[n].tail);
+        n = tim_collapse(runs, n + 1);
+    }
+    while (n > 1) {
+        int i = n - 2;
+        if (i > 0 && runs[i - 1].len < runs[i + 1].len)
+            i--;
+        tim_merge_at(runs, i, n--);
+    }
+
+    struct list_head *prev = head;
+    for (struct list_head *it = runs[0].list; it; it = it->next) {
+        prev->next = it;
+        it->prev = prev;
+        prev = it;
+    }
+    head->prev = prev;
+    prev->next = head;
+}
+
+/* Buckets with fewer nodes than this are finished by comparison sort */
+#define RADIX_CUTOFF 32
+
+/* Beyond this many bytes of common prefix, comparison sort takes over so that
+ * the recursion, and the bucket array on every level, stays bounded.
+ */
+#define RADIX_MAX_DEPTH 64
+
+/* Compare strings ignoring the first *priv bytes, known to be equal */
+static int cmp_suffix(void *priv,
+                      const struct list_head *a,
+                      const struct list_head *b)
+{
+    size_t depth = *(size_t *) priv;
+    if (depth < 8)
+        return node_cmp(a, b);
+    return strcmp(getvalue(a) + depth, getvalue(b) + depth);
+}
+
+/*
+ * Sort the n nodes of list, whose strings share their first depth bytes.
+ * Nodes are distributed by the byte at depth into one bucket per byte value,
+ * keeping their relative order, then every bucket holding more than one
+ * string is sorted on the following byte. Bucket 0 holds the strings ending
+ * here, which are all equal.
+ */
+static void radix_sort(struct list_head *list, size_t n, size_t depth)
+{
+    if (n < RADIX_CUTOFF || depth >= RADIX_MAX_DEPTH) {
+        list_sort(&depth, list, cmp_suffix);
+        return;
+    }
+
+    struct list_head buckets[256];
+    size_t count[256];
+    int lo = 255, hi = 0;
+    for (int c = 0; c < 256; c++) {
+        INIT_LIST_HEAD(&buckets[c]);
+        count[c] = 0;
+    }
+
+    struct list_head *node, *safe;
+    list_for_each_safe (node, safe, list) {
+        /* The first 8 bytes are found in the cached prefix */
+        unsigned char c =
+            depth < 8
+                ? list_entry(node, element_t, list)->key >> (56 - 8 * depth)
+                : getvalue(node)[depth];
+        list_add_tail(node, &buckets[c]);
+        count[c]++;
+        if (c < lo)
+            lo = c;
+        if (c > hi)
+            hi = c;
+    }
+
+    INIT_LIST_HEAD(list);
+    for (int c = lo; c <= hi; c++) {
+        if (c && count[c] > 1)
+            radix_sort(&buckets[c], count[c], depth + 1);
+        list_splice_tail(&buckets[c], list);
+    }
+}
+
+/*
+ * Sort elements of queue in ascending order with MSD radix sort.
+ * No effect if q is NULL or empty. In addition, if q has only one
+ * element, do nothing.
+ */
+void q_sort_radix(struct list_head *head)
+{
+    if (!head)
+        return;
+    if (sort_bare(head))
+        return;
+    if (lend(head)) {
+        q_sort_radix(head);
+        take_back(head);
+        return;
+    }
+    if (list_is_singular(head) || list_empty(head))
+        return;
+    q_ctx(head)->mid = NULL;
+    radix_sort(head, q_size(head), 0);
+}
+
+/* Memory the external sort may use per element of its budget: what a short
+ * element takes, so that read buffers never outweigh the elements sorted in
+ * memory at a time
+ */
+#define EXT_ELE_BYTES (sizeof(element_t) + ELE_INLINE_LEN)
+
+/* Fewest bytes worth reading a run through */
+#define EXT_MIN_BUF 4096
+
+/* Sorted run in one of the temporary files. Records are a 32-bit length
+ * followed by the string and its terminating NUL.
+ */
+struct ext_span {
+    FILE *f;
+    off_t pos, end;
+};
+
+/* Reader of a run, so the current string can be used straight from buf */
+struct ext_run {
+    int fd;
+    off_t pos, end;    /* part of the run not read into buf yet */
+    char *buf;         /* buffered bytes are buf[head, tail) */
+    size_t cap, head, tail;
+    const char *str; /* current string, points into buf */
+};
+
+static void ext_open(struct ext_run *r, const struct ext_span *span)
+{
+    r->fd = fileno(span->f);
+    r->pos = span->pos;
+    r->end = span->end;
+    r->head = r->tail = 0;
+}
+
+/* Make the next string of run r current.
+ * Return 1 on success, 0 at end of run and -1 if reading failed.
+ */
+static int ext_next(struct ext_run *r)
+{
+    for (;;) {
+        size_t avail = r->tail - r->head;
+        uint32_t len;
+        if (avail >= sizeof(len)) {
+            memcpy(&len, r->buf + r->head, sizeof(len));
+            if (avail >= sizeof(len) + len + 1) {
+                r->str = r->buf + r->head + sizeof(len);
+                r->head += sizeof(len) + len + 1;
+                return 1;
+            }
+        }
+        if (r->pos == r->end)
+            return avail ? -1 : 0;
+
+        /* Move the partial record to the front and refill behind it */
+        memmove(r->buf, r->buf + r->head, avail);
+        r->head = 0;
+        r->tail = avail;
+        size_t want = r->cap - avail;
+        if ((off_t) want > r->end - r->pos)
+            want = r->end - r->pos;
+        ssize_t got = pread(r->fd, r->buf + avail, want, r->pos);
+        if (got <= 0)
+            return -1;
+        r->pos += got;
+        r->tail += got;
+    }
+}
+
+/* Where merged strings go: appended to a run of f, or to the queue q as new
+ * elements when f is NULL
+ */
+struct ext_sink {
+    FILE *f;
+    off_t end;
+    queue_t *q;
+};
+
+static bool ext_put(struct ext_sink *out, const char *s)
+{
+    uint32_t len = strlen(s);
+    if (!out->f)
+        return q_insert_tail(&out->q->head, (char *) s);
+    if (fwrite(&len, sizeof(len), 1, out->f) != 1 ||
+        fwrite(s, 1, len + 1, out->f) != len + 1)
+        return false;
+    out->end += sizeof(len) + len + 1;
+    return true;
+}
+
+/* Does run a come before run b in the merge? Ties go to the earlier run,
+ * which holds the earlier part of the queue.
+ */
+static bool ext_before(const struct ext_run *runs, int a, int b)
+{
+    int c = strcmp(runs[a].str, runs[b].str);
+    return c ? c < 0 : a < b;
+}
+
+static void ext_sift_down(const struct ext_run *runs, int *heap, int n, int i)
+{
+    for (;;) {
+        int min = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && ext_before(runs, heap[l], heap[min]))
+            min = l;
+        if (r < n && ext_before(runs, heap[r], heap[min]))
+            min = r;
+        if (min == i)
+            return;
+        int t = heap[i];
+        heap[i] = heap[min];
+        heap[min] = t;
+        i = min;
+    }
+}
+
+/* Merge the k runs opened in runs into out, return false if reading or
+ * writing failed
+ */
+static bool ext_merge(struct ext_run *runs,
+                      int k,
+                      int *heap,
+                      struct ext_sink *out)
+{
+    int n = 0;
+    for (int r = 0; r < k; r++) {
+        int got = ext_next(&runs[r]);
+        if (got < 0)
+            return false;
+        if (got)
+            heap[n++] = r;
+    }
+    for (int i = n / 2 - 1; i >= 0; i--)
+        ext_sift_down(runs, heap, n, i);
+    while (n) {
+        int r = heap[0];
+        if (!ext_put(out, runs[r].str))
+            return false;
+        int got = ext_next(&runs[r]);
+        if (got < 0)
+            return false;
+        if (!got)
+            heap[0] = heap[--n];
+        ext_sift_down(runs, heap, n, 0);
+    }
+    return out->f ? !fflush(out->f) : true;
+}
+
+static int ext_cmp(const void *a, const void *b)
+{
+    return ele_cmp(*(element_t *const *) a, *(element_t *const *) b);
+}
+
+/* Sort the first n elements of the queue, gathered in chunk, spill them to
+ * a run of f and delete them. Return false if writing failed, the queue is
+ * then left as it was.
+ */
+static bool ext_spill(queue_t *q,
+                      element_t **chunk,
+                      size_t n,
+                      struct ext_span *span)
+{
+    struct ext_sink out = {.f = span->f, .end = span->pos};
+    qsort(chunk, n, sizeof(*chunk), ext_cmp);
+    for (size_t i = 0; i < n; i++) {
+        if (!ext_put(&out, chunk[i]->value))
+            return false;
+    }
+    if (fflush(span->f))
+        return false;
+    span->end = out.end;
+    for (size_t i = 0; i < n; i++)
+        q_release_element(q_remove_head(&q->head, NULL, 0));
+    return true;
+}
+
+/* Read the n runs in span back to the queue one after the other, through
+ * the reader r. Return false if a string could not be read or stored.
+ */
+static bool ext_restore(queue_t *q,
+                        const struct ext_span *span,
+                        int n,
+                        struct ext_run *r)
+{
+    struct ext_sink out = {.q = q};
+    bool ok = true;
+    for (int i = 0; i < n; i++) {
+        ext_open(r, &span[i]);
+        int got;
+        while ((got = ext_next(r)) > 0) {
+            if (!ext_put(&out, r->str))
+                break;
+        }
+        ok = ok && !got;
+    }
+    return ok;
+}
+
+bool q_sort_external(struct list_head *head, size_t budget)
+{
+    if (!head)
+        return true;
+    queue_t *q = q_ctx(head);
+    if (!budget || (size_t) q->size <= budget) {
+        q_sort(head);
+        return true;
+    }
+
+    /* A read buffer holds at least one record of the longest string. The
+     * buffers of a merge share the memory of the budget, which limits how
+     * many runs are merged at a time.
+     */
+    int nspans = (q->size + budget - 1) / budget;
+    size_t max_len = 0;
+    q_iter_t it;
+    element_t *e;
+    for (e = q_iter_first(&it, head); e; e = q_iter_next(&it)) {
+        size_t len = strlen(e->value);
+        if (len > max_len)
+            max_len = len;
+    }
+    size_t min_buf = max_len + sizeof(uint32_t) + 1;
+    if (min_buf < EXT_MIN_BUF)
+        min_buf = EXT_MIN_BUF;
+    size_t total = budget * EXT_ELE_BYTES;
+    int fan_in = total / min_buf < 2 ? 2 : total / min_buf;
+    if (fan_in > nspans)
+        fan_in = nspans;
+    size_t cap = total / fan_in < min_buf ? min_buf : total / fan_in;
+
+    /* Get everything the merge needs before the queue is taken apart */
+    FILE *src = tmpfile(), *dst = tmpfile();
+    struct ext_span *span = malloc(2 * nspans * sizeof(*span));
+    struct ext_run *runs = malloc(fan_in * sizeof(*runs));
+    int *heap = malloc(fan_in * sizeof(*heap));
+    element_t **chunk = malloc(budget * sizeof(*chunk));
+    int nbuf = 0;
+    if (src && dst && span && runs && heap && chunk) {
+        for (; nbuf < fan_in; nbuf++) {
+            runs[nbuf].buf = malloc(cap);
+            if (!runs[nbuf].buf)
+                break;
+            runs[nbuf].cap = cap;
+        }
+    }
+    bool ok = nbuf == fan_in;
+    if (!ok) {
+        q_sort(head);
+        goto out;
+    }
+
+    /* Sort budget-sized chunks in memory and spill each as a run of src,
+     * deleting its elements
+     */
+    struct ext_span *cur = span, *next = span + nspans;
+    int n = 0;
+    off_t pos = 0;
+    while (q->size) {
+        size_t k = 0;
+        for (e = q_iter_first(&it, head); e && k < budget;
+             e = q_iter_next(&it))
+            chunk[k++] = e;
+        cur[n] = (struct ext_span){src, pos, pos};
+        if (!ext_spill(q, chunk, k, &cur[n])) {
+            ok = false;
+            break;
+        }
+        pos = cur[n++].end;
+    }
+
+    /* Merge fan_in runs at a time into runs of the other file, until one
+     * merge can go straight to the queue
+     */
+    while (ok && n > fan_in) {
+        int m = 0, done = 0;
+        off_t end = 0;
+        for (; done < n; m++) {
+            int k = n - done < fan_in ? n - done : fan_in;
+            for (int i = 0; i < k; i++)
+                ext_open(&runs[i], &cur[done + i]);
+            struct ext_sink out = {.f = dst, .end = end};
+            if (!ext_merge(runs, k, heap, &out)) {
+                ok = false;
+                break;
+            }
+            next[m] = (struct ext_span){dst, end, out.end};
+            end = out.end;
+            done += k;
+        }
+        if (!ok) {
+            /* Runs merged so far are complete, the rest is still in src */
+            memmove(next + m, cur + done, (n - done) * sizeof(*cur));
+            n = m + n - done;
+            cur = next;
+            break;
+        }
+        struct ext_span *t = cur;
+        cur = next;
+        next = t;
+        n = m;
+        /* The old runs are merged, reuse their file for the next pass */
+        FILE *f = src;
+        src = dst;
+        dst = f;
+        if (ftruncate(fileno(dst), 0) || fseeko(dst, 0, SEEK_SET))
+            ok = false;
+    }
+
+    if (ok) {
+        for (int i = 0; i < n; i++)
+            ext_open(&runs[i], &cur[i]);
+        struct ext_sink out = {.q = q};
+        ok = ext_merge(runs, n, heap, &out);
+    } else {
+        /* Writing failed: read everything back and sort it in memory */
+        ext_restore(q, cur, n, &runs[0]);
+        q_sort(head);
+    }
+
+out:
+    for (int r = 0; r < nbuf; r++)
+        free(runs[r].buf);
+    free(runs);
+    free(heap);
+    free(chunk);
+    free(span);
+    if (src)
+        fclose(src);
+    if (dst)
+        fclose(dst);
+    return ok;
+}
+
+/* Lists of up to this many nodes are permuted directly by Fisher-Yates */
+#define SHUFFLE_BASE 256
+
+/* Number of buckets longer lists are scattered into */
+#define SHUFFLE_FANOUT 256
+
+static uint64_t shuffle_state;
+static bool shuffle_seeded = false;
+
+void q_shuffle_seed(unsigned int seed)
+{
+    shuffle_state = seed;
+    shuffle_seeded = true;
+}
+
+/* Return the next 32 random bits (splitmix64) */
+static uint32_t shuffle_bits(void)
+{
+    uint64_t z = (shuffle_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z >> 32;
+}
+
+/*
+ * Return a uniformly distributed number below bound, which must not be 0.
+ * Lemire, "Fast Random Integer Generation in an Interval", 2019: the high
+ * half of a 32x32-bit product, rejecting the few low halves that would
+ * favour some results.
+ */
+uint32_t shuffle_rand(uint32_t bound)
+{
+    uint64_t m = (uint64_t) shuffle_bits() * bound;
+    uint32_t lo = (uint32_t) m;
+    if (lo < bound) {
+        uint32_t threshold = -bound % bound;
+        while (lo < threshold) {
+            m = (uint64_t) shuffle_bits() * bound;
+            lo = (uint32_t) m;
+        }
+    }
+    return m >> 32;
+}
+
+/*
+ * Shuffle the n nodes of list.
+ * Short lists get a Fisher-Yates pass over an on-stack array of their nodes.
+ * Longer ones are scattered into uniformly chosen buckets, which are shuffled
+ * recursively and concatenated again (Rao-Sandelius). The result is still a
+ * uniform permutation, each level is a single pass, and no heap memory is
+ * needed since q_shuffle runs where allocation is forbidden.
+ */
+static void shuffle_list(struct list_head *list, size_t n)
+{
+    struct list_head *node, *safe;
+
+    if (n <= SHUFFLE_BASE) {
+        struct list_head *nodes[SHUFFLE_BASE];
+        size_t i = 0;
+        list_for_each (node, list)
+            nodes[i++] = node;
+        for (i = n; i > 1; i--) {
+            size_t j = shuffle_rand(i);
+            node = nodes[i - 1];
+            nodes[i - 1] = nodes[j];
+            nodes[j] = node;
+        }
+        INIT_LIST_HEAD(list);
+        for (i = 0; i < n; i++)
+            list_add_tail(nodes[i], list);
+        return;
+    }
+
+    struct list_head buckets[SHUFFLE_FANOUT];
+    size_t count[SHUFFLE_FANOUT] = {0};
+    for (int b = 0; b < SHUFFLE_FANOUT; b++)
+        INIT_LIST_HEAD(&buckets[b]);
+
+    list_for_each_safe (node, safe, list) {
+        uint32_t b = shuffle_rand(SHUFFLE_FANOUT);
+        list_add_tail(node, &buckets[b]);
+        count[b]++;
+    }
+
+    INIT_LIST_HEAD(list);
+    for (int b = 0; b < SHUFFLE_FANOUT; b++) {
+        if (count[b] > 1)
+            shuffle_list(&buckets[b], count[b]);
+        list_splice_tail(&buckets[b], list);
+    }
+}
+
+/*
+ * Shuffle the list in random.
+ * The generator is seeded from the clock unless q_shuffle_seed() was called,
+ * so that a given seed reproduces the same sequence of shuffles.
+ */
+void q_shuffle(struct list_head *head)
+{
+    if (!head)
+        return;
+    queue_t *q = q_ctx(head);
+    if (bare(q)) {
+        if (q->size < 2)
+            return;
+        if (!shuffle_seeded)
+            q_shuffle_seed(time(NULL));
+        q->ops->shuffle(q);
+        return;
+    }
+    if (lend(head)) {
+        q_shuffle(head);
+        take_back(head);
+        return;
+    }
+    if (list_is_singular(head) || list_empty(head))
+        return;
+
+    if (!shuffle_seeded)
+        q_shuffle_seed(time(NULL));
+    q->mid = NULL;
+    shuffle_list(head, q_size(head));
 }
@@ -9,21 +9,107 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "harness.h"
 #include "list.h"
 
 /**
  * element_t - Linked list element
  * @value: pointer to array holding string
+ * @key: first 8 bytes of @value packed big-endian, zero padded
+ * @hash: FNV-1a hash of @value
+ * @flags: ELE_* bits describing where the element lives
  * @list: node of a doubly-linked list
+ * @data: storage of the string @value points to
  *
- * @value needs to be explicitly allocated and freed
+ * The element and its string come from a single allocation: @value points
+ * into the trailing @data, so the leading bytes of the key share a cache line
+ * with @list and releasing the element is one free. Queue kinds that keep
+ * their elements without list nodes allocate them without @list, and @value
+ * points where @list would be.
+ *
+ * Comparing @key as integers orders elements like strcmp() does on their
+ * first 8 bytes, which settles most comparisons without touching @value.
  */
 typedef struct {
     char *value;
+    uint64_t key;
+    uint32_t hash;
+    unsigned int flags;
     struct list_head list;
+    char data[];
 } element_t;
 
+/* Element is carved from the arena of its queue and owned by it */
+#define ELE_ARENA 0x1
+
+/* Element's string occurs more than once, used while deleting duplicates */
+#define ELE_DUP 0x2
+
+/* Strings shorter than this are stored in a fixed-size element, so that all
+ * short-string elements share one allocation size and fill the remainder of
+ * the first cache line.
+ */
+#define ELE_INLINE_LEN (64 - offsetof(element_t, data))
+
+struct q_arena;
+struct q_ops;
+
+/**
+ * queue_t - Queue context wrapping the list head handed out by q_new()
+ * @head: sentinel of the circular doubly-linked list of elements
+ * @size: number of elements in the queue
+ * @mid: node q_delete_mid() removes next, NULL if empty or not known since
+ *       the queue was last reordered
+ * @arena: newest chunk elements are carved from, NULL for heap elements
+ * @ops: storage of a queue of another kind than a linked list, NULL for a
+ *       linked list
+ * @store: private data of @ops
+ * @lent: elements of a queue of another kind are linked into @head for the
+ *        moment, and it is handled as a linked list
+ *
+ * Callers only ever see &queue_t.head; q_ctx() recovers the enclosing
+ * context. Every operation in queue.c that links or unlinks elements keeps
+ * the metadata up to date, so it can be read in constant time.
+ *
+ * Queues of other kinds keep @head empty and store the elements behind
+ * @ops. Operations that rearrange the whole queue link the elements into
+ * @head, run the linked-list code and store them back. Use q_iter_first()
+ * and q_iter_next() to walk a queue of any kind.
+ */
+typedef struct {
+    struct list_head head;
+    int size;
+    struct list_head *mid;
+    struct q_arena *arena;
+    const struct q_ops *ops;
+    void *store;
+    bool lent;
+} queue_t;
+
+/**
+ * q_iter_t - Position in a queue of any kind
+ * @head: header of queue
+ * @pos: list node of the current element, or storage holding it
+ * @slot: index of the current element in @pos, when it holds several
+ */
+typedef struct {
+    struct list_head *head;
+    void *pos;
+    int slot;
+} q_iter_t;
+
+/**
+ * q_ctx() - Get the queue context from the list head returned by q_new()
+ * @head: header of queue
+ *
+ * Return: the queue context containing @head
+ */
+static inline queue_t *q_ctx(struct list_head *head)
+{
+    return list_entry(head, queue_t, head);
+}
+
 /* Operations on queue */
 
 /**
@@ -33,6 +119,66 @@ typedef struct {
  */
 struct list_head *q_new();
 
+/**
+ * q_new_arena() - Create an empty queue backed by an arena
+ *
+ * Elements of the queue and their strings are carved from large chunks owned
+ * by the queue instead of being allocated one by one, and q_free() releases
+ * the chunks as a whole. Elements removed from such a queue stay valid until
+ * the queue is freed; q_release_element() has no effect on them.
+ *
+ * Return: NULL for allocation failed
+ */
+struct list_head *q_new_arena();
+
+/**
+ * q_new_unrolled() - Create an empty queue stored as an unrolled list
+ *
+ * Instead of linking the elements one by one, the queue keeps pointers to
+ * them in a doubly-linked list of blocks with room for several dozen each,
+ * so walking the queue touches one block per few dozen elements. Elements
+ * are allocated without list nodes. Reversing and swapping move pointers
+ * within and between blocks. Sorting and shuffling work on each block
+ * first, then merge runs of blocks. An element removed from the queue
+ * cannot be linked into a list. Building with QUEUE=unrolled makes q_new()
+ * create this kind of queue.
+ *
+ * Return: NULL for allocation failed
+ */
+struct list_head *q_new_unrolled();
+
+/**
+ * q_new_pool() - Create an empty queue stored in a pool of index-linked nodes
+ *
+ * Nodes pointing to the elements live in one array that grows and shrinks by
+ * doubling, and link to each other with 32-bit indices instead of pointers.
+ * The nodes in use are kept at the front of the array, and sorting lays them
+ * out in queue order again. Elements are allocated without list nodes, so
+ * links take 8 bytes per element instead of 16, and walks scan an array
+ * instead of chasing pointers. Reversing, swapping, sorting and shuffling
+ * work on the nodes; an element removed from the queue cannot be linked
+ * into a list.
+ *
+ * Return: NULL for allocation failed
+ */
+struct list_head *q_new_pool();
+
+/* Largest capacity of a ring buffer queue */
+#define RING_MAX_CAPACITY (1U << 30)
+
+/**
+ * q_new_ring() - Create an empty queue stored in a ring buffer
+ * @capacity: most elements the queue can hold, rounded up to a power of two
+ *
+ * The queue keeps pointers to its elements in one array allocated up front,
+ * so inserting and removing at either end never allocates anything beyond
+ * the element itself. Inserting into a full queue fails like running out of
+ * memory does.
+ *
+ * Return: NULL for allocation failed or @capacity above RING_MAX_CAPACITY
+ */
+struct list_head *q_new_ring(unsigned int capacity);
+
 /**
  * q_free() - Free all storage used by queue, no effect if header is NULL
  * @head: header of queue
@@ -93,6 +239,25 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize);
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
 
+/**
+ * q_new_element() - Allocate an element holding a copy of a string
+ * @s: string to be stored
+ *
+ * The element belongs to no queue yet; it is meant for containers outside
+ * this file that hand out elements the way q_remove_head() does.
+ *
+ * Return: the element, NULL if @s is NULL or allocation failed
+ */
+element_t *q_new_element(char *s);
+
+/**
+ * q_rekey_element() - Update the cached key and hash of an element
+ * @e: element whose string was rewritten in place, not longer than before
+ *
+ * To be called before @e is compared or hashed again.
+ */
+void q_rekey_element(element_t *e);
+
 /**
  * q_release_element() - Release the element
  * @e: element would be released
@@ -101,8 +266,8 @@ element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
  */
 static inline void q_release_element(element_t *e)
 {
-    test_free(e->value);
-    test_free(e);
+    if (!(e->flags & ELE_ARENA))
+        test_free(e);
 }
 
 /**
@@ -113,6 +278,33 @@ static inline void q_release_element(element_t *e)
  */
 int q_size(struct list_head *head);
 
+/**
+ * q_iter_first() - Start walking a queue from its head
+ * @it: iterator to set up
+ * @head: header of queue
+ *
+ * The queue must not be changed while it is being walked.
+ *
+ * Return: the first element, NULL if queue is NULL or empty
+ */
+element_t *q_iter_first(q_iter_t *it, struct list_head *head);
+
+/**
+ * q_iter_next() - Step to the next element of the queue being walked
+ * @it: iterator set up by q_iter_first()
+ *
+ * Return: the next element, NULL past the tail of the queue
+ */
+element_t *q_iter_next(q_iter_t *it);
+
+/**
+ * q_peek_tail() - Get the element at the tail without removing it
+ * @head: header of queue
+ *
+ * Return: the last element, NULL if queue is NULL or empty
+ */
+element_t *q_peek_tail(struct list_head *head);
+
 /**
  * q_delete_mid() - Delete the middle node in queue
  * @head: header of queue
@@ -140,6 +332,22 @@ bool q_delete_mid(struct list_head *head);
  */
 bool q_delete_dup(struct list_head *head);
 
+/**
+ * q_delete_dup_hash() - Delete all nodes that have duplicate string from a
+ *                       queue in any order
+ * @head: header of queue
+ *
+ * Same result as q_delete_dup(), but the queue needs not be sorted: strings
+ * are counted in a hash table built from the cached element hashes, then
+ * every node whose string was seen twice is deleted. The distinct strings
+ * keep their relative order. Runs in O(n) and allocates a table of about
+ * two pointers per element.
+ *
+ * Return: true for success, false if list is NULL or the table could not be
+ * allocated, in which case the queue is unchanged.
+ */
+bool q_delete_dup_hash(struct list_head *head);
+
 /**
  * q_delete_dup() - Swap every two adjacent nodes
  * @head: header of queue
@@ -178,13 +386,99 @@ void q_sort(struct list_head *head);
  */
 void q_sort_topdown(struct list_head *head);
 
+/**
+ * q_sort_unique() - Sort elements of queue in ascending order and delete all
+ *                   nodes that have duplicate string
+ * @head: header of queue
+ *
+ * Same result as q_sort() followed by q_delete_dup(), in a single traversal:
+ * the final merge of the sort deletes the duplicates while relinking the
+ * list.
+ *
+ * Return: true for success, false if list is NULL.
+ */
+bool q_sort_unique(struct list_head *head);
+
+/**
+ * q_sort_parallel() - Sort elements of queue in ascending order on threads
+ * @head: header of queue
+ * @nthreads: most segments to sort at once
+ *
+ * The queue is split into segments sorted concurrently as tasks of the
+ * fork-join pool (concurrent/forkjoin.h), which are then merged back.
+ * Short queues use fewer threads, down to a plain q_sort(). Equal strings
+ * keep their relative order.
+ *
+ * No effect if queue is NULL or empty. If there has only one element, do
+ * nothing.
+ */
+void q_sort_parallel(struct list_head *head, int nthreads);
+
+/**
+ * q_sort_adaptive() - Sort elements of queue in ascending order (Timsort)
+ * @head: header of queue
+ *
+ * Natural runs are detected in one pass, descending ones reversed in place,
+ * and runs merged with galloping, so queues that are already mostly in order
+ * sort in close to linear time. Equal strings keep their relative order.
+ *
+ * No effect if queue is NULL or empty. If there has only one element, do
+ * nothing.
+ */
+void q_sort_adaptive(struct list_head *head);
+
+/**
+ * q_sort_radix() - Sort elements of queue in ascending order (MSD radix sort)
+ * @head: header of queue
+ *
+ * Nodes are bucketed by successive bytes of their strings, small buckets are
+ * finished by comparison sort. Equal strings keep their relative order.
+ *
+ * No effect if queue is NULL or empty. If there has only one element, do
+ * nothing.
+ */
+void q_sort_radix(struct list_head *head);
+
+/**
+ * q_sort_external() - Sort elements of queue in ascending order through disk
+ * @head: header of queue
+ * @budget: most elements sorted in memory at a time, 0 for no limit
+ *
+ * A queue longer than @budget is cut into chunks of @budget elements. Each
+ * chunk is sorted in memory, written to a temporary file as a sorted run and
+ * released. The runs are merged in passes between two temporary files, as
+ * many at a time as read buffers fit in the memory of @budget short
+ * elements, and the last merge stores the strings in new elements of the
+ * queue. Besides the queue itself, memory stays within about what @budget
+ * elements take. Shorter queues are sorted in memory. Equal strings keep
+ * their relative order.
+ *
+ * Return: true for success, false if memory for the merge ran out or a file
+ * could not be written or read back. When writing fails, the runs are read
+ * back and the queue is sorted in memory instead; strings that could not be
+ * read back or stored in new elements are lost.
+ */
+bool q_sort_external(struct list_head *head, size_t budget);
+
 /**
  * q_shuffle() - Shuffle the list in random
  * @head: header of queue
  *
+ * Every permutation is equally likely. Runs in linear time and does not
+ * allocate memory.
+ *
  * No effect if queue is NULL or empty. If there has only one element, do
  * nothing.
  */
 void q_shuffle(struct list_head *head);
 
+/**
+ * q_shuffle_seed() - Seed the generator used by q_shuffle
+ * @seed: seed value
+ *
+ * The same seed followed by the same operations yields the same shuffles.
+ * Without a call to this function the generator is seeded from the clock.
+ */
+void q_shuffle_seed(unsigned int seed);
+
 #endif /* LAB0_QUEUE_H */
@@ -0,0 +1,91 @@
+#ifndef LAB0_QUEUE_OPS_H
+#define LAB0_QUEUE_OPS_H
+
+/* Storage of queue kinds other than the circular doubly-linked list.
+ *
+ * queue.c allocates and releases the elements and keeps queue_t.size up to
+ * date; a kind only decides where the element pointers live. Operations are
+ * only called on a queue holding at least one element, except the push ones.
+ * A kind without lend() keeps its elements without list nodes, queue.c then
+ * allocates them without one and leaves reordering the queue to the kind.
+ */
+
+#include <string.h>
+
+#include "queue.h"
+
+/**
+ * struct q_ops - Operations of a queue kind
+ * @push_head: store e in front of all elements, false if out of memory
+ * @push_tail: store e behind all elements, false if out of memory
+ * @pop_head: take out the first element
+ * @pop_tail: take out the last element
+ * @pop_at: take out the element with 0-based index i
+ * @first: point it at the first element and return it
+ * @next: step it to the next element, NULL past the last one
+ * @last: return the last element
+ * @set: store e at the position of it instead of the element there
+ * @lend: link all elements in order into q->head through their list nodes.
+ *        Must not allocate, and must keep room for as many elements. NULL if
+ *        the elements have no list nodes, the four below are then required
+ * @take_back: store the elements linked into q->head again, in list order.
+ *             Never more than were lent, so it must not allocate either
+ * @reverse: reverse the order of the elements
+ * @swap: swap every two adjacent elements
+ * @sort: sort the elements by ele_cmp(), keeping equal ones in order
+ * @shuffle: put the elements in uniformly random order by shuffle_rand()
+ * @destroy: release the storage, the elements are gone already
+ *
+ * None of the operations reordering the queue may allocate.
+ */
+struct q_ops {
+    bool (*push_head)(queue_t *q, element_t *e);
+    bool (*push_tail)(queue_t *q, element_t *e);
+    element_t *(*pop_head)(queue_t *q);
+    element_t *(*pop_tail)(queue_t *q);
+    element_t *(*pop_at)(queue_t *q, int i);
+    element_t *(*first)(queue_t *q, q_iter_t *it);
+    element_t *(*next)(q_iter_t *it);
+    element_t *(*last)(queue_t *q);
+    void (*set)(q_iter_t *it, element_t *e);
+    void (*lend)(queue_t *q);
+    void (*take_back)(queue_t *q);
+    void (*reverse)(queue_t *q);
+    void (*swap)(queue_t *q);
+    void (*sort)(queue_t *q);
+    void (*shuffle)(queue_t *q);
+    void (*destroy)(queue_t *q);
+};
+
+/*
+ * Compare the strings of two elements like strcmp(), deciding on the cached
+ * prefixes first. Equal prefixes ending in a NUL byte cover whole strings,
+ * otherwise only the bytes past the prefix are left to compare.
+ */
+static inline int ele_cmp(const element_t *a, const element_t *b)
+{
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    if (!(a->key & 0xff))
+        return 0;
+    return strcmp(a->value + 8, b->value + 8);
+}
+
+/* Return a uniformly distributed number below bound, which must not be 0 */
+uint32_t shuffle_rand(uint32_t bound);
+
+/* Set up the storage of an empty queue, false if out of memory */
+bool unrolled_init(queue_t *q);
+extern const struct q_ops unrolled_ops;
+
+/* Set up the storage of an empty queue for capacity elements, rounded up to
+ * a power of two. False if out of memory or capacity is too large.
+ */
+bool ring_init(queue_t *q, unsigned int capacity);
+extern const struct q_ops ring_ops;
+
+/* Set up the storage of an empty queue, false if out of memory */
+bool pool_init(queue_t *q);
+extern const struct q_ops pool_ops;
+
+#endif /* LAB0_QUEUE_OPS_H */
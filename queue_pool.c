@@ -0,0 +1,316 @@
+/* Node pool queue kind: nodes in one array, linked by 32-bit indices */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "queue_ops.h"
+
+/* Fewest nodes the pool has room for, it grows and shrinks by doubling */
+#define POOL_MIN_NODES 64
+
+/* Node 0 is the sentinel. Nodes 1..size are in use, so the pool stays
+ * compact and a node is found again by its index after the array moves.
+ * The elements have no list nodes, the queue is reordered by moving element
+ * pointers between nodes. Sorting lays the nodes out in queue order and
+ * borrows their links as the second array of a merge sort.
+ */
+struct pnode {
+    union {
+        struct {
+            uint32_t next, prev;
+        };
+        element_t *spare;
+    };
+    element_t *e;
+};
+
+struct pool {
+    uint32_t cap; /* nodes, the sentinel not counted */
+    struct pnode *node;
+};
+
+#define pool(q) ((struct pool *) (q)->store)
+
+/* Move the first used + 1 nodes to an array with room for cap nodes */
+static bool pool_resize(struct pool *p, uint32_t cap, uint32_t used)
+{
+    struct pnode *n = malloc((cap + 1) * sizeof(struct pnode));
+    if (!n)
+        return false;
+    if (p->node) {
+        memcpy(n, p->node, (used + 1) * sizeof(struct pnode));
+        free(p->node);
+    }
+    p->node = n;
+    p->cap = cap;
+    return true;
+}
+
+bool pool_init(queue_t *q)
+{
+    struct pool *p = malloc(sizeof(struct pool));
+    if (!p)
+        return false;
+    p->node = NULL;
+    if (!pool_resize(p, POOL_MIN_NODES, 0)) {
+        free(p);
+        return false;
+    }
+    p->node[0].next = p->node[0].prev = 0;
+    q->store = p;
+    return true;
+}
+
+/* Link e in a new node at the head or the tail */
+static bool pool_link(queue_t *q, element_t *e, bool tail)
+{
+    struct pool *p = pool(q);
+    uint32_t x = q->size + 1;
+    if (x > p->cap && !pool_resize(p, p->cap * 2, q->size))
+        return false;
+    struct pnode *n = p->node;
+    uint32_t prev = tail ? n[0].prev : 0, next = n[prev].next;
+    n[x].next = next;
+    n[x].prev = prev;
+    n[x].e = e;
+    n[prev].next = x;
+    n[next].prev = x;
+    return true;
+}
+
+/* Unlink node x and move the last node into its place */
+static element_t *pool_unlink(queue_t *q, uint32_t x)
+{
+    struct pool *p = pool(q);
+    struct pnode *n = p->node;
+    element_t *e = n[x].e;
+    n[n[x].prev].next = n[x].next;
+    n[n[x].next].prev = n[x].prev;
+
+    uint32_t last = q->size;
+    if (x != last) {
+        n[x] = n[last];
+        n[n[x].prev].next = x;
+        n[n[x].next].prev = x;
+    }
+    /* Giving memory back is optional, keep the pool if it fails */
+    if (p->cap > POOL_MIN_NODES && last - 1 < p->cap / 4)
+        pool_resize(p, p->cap / 2, last - 1);
+    return e;
+}
+
+static bool pool_push_head(queue_t *q, element_t *e)
+{
+    return pool_link(q, e, false);
+}
+
+static bool pool_push_tail(queue_t *q, element_t *e)
+{
+    return pool_link(q, e, true);
+}
+
+static element_t *pool_pop_head(queue_t *q)
+{
+    return pool_unlink(q, pool(q)->node[0].next);
+}
+
+static element_t *pool_pop_tail(queue_t *q)
+{
+    return pool_unlink(q, pool(q)->node[0].prev);
+}
+
+/* Walk to node i from the nearer end */
+static element_t *pool_pop_at(queue_t *q, int i)
+{
+    struct pnode *n = pool(q)->node;
+    uint32_t x;
+    if (i < q->size / 2) {
+        for (x = n[0].next; i; i--)
+            x = n[x].next;
+    } else {
+        for (x = n[0].prev, i = q->size - 1 - i; i; i--)
+            x = n[x].prev;
+    }
+    return pool_unlink(q, x);
+}
+
+static element_t *pool_first(queue_t *q, q_iter_t *it)
+{
+    struct pool *p = pool(q);
+    it->pos = p;
+    it->slot = p->node[0].next;
+    return p->node[it->slot].e;
+}
+
+static element_t *pool_next(q_iter_t *it)
+{
+    struct pnode *n = ((struct pool *) it->pos)->node;
+    it->slot = n[it->slot].next;
+    return it->slot ? n[it->slot].e : NULL;
+}
+
+static element_t *pool_last(queue_t *q)
+{
+    struct pnode *n = pool(q)->node;
+    return n[n[0].prev].e;
+}
+
+static void pool_set(q_iter_t *it, element_t *e)
+{
+    ((struct pool *) it->pos)->node[it->slot].e = e;
+}
+
+/* Swap the elements of the nodes at both ends, stepping inwards */
+static void pool_reverse(queue_t *q)
+{
+    struct pnode *n = pool(q)->node;
+    uint32_t a = n[0].next, b = n[0].prev;
+    for (int i = q->size / 2; i; i--) {
+        element_t *e = n[a].e;
+        n[a].e = n[b].e;
+        n[b].e = e;
+        a = n[a].next;
+        b = n[b].prev;
+    }
+}
+
+static void pool_swap(queue_t *q)
+{
+    struct pnode *n = pool(q)->node;
+    for (uint32_t a = n[0].next; a && n[a].next; a = n[n[a].next].next) {
+        uint32_t b = n[a].next;
+        element_t *e = n[a].e;
+        n[a].e = n[b].e;
+        n[b].e = e;
+    }
+}
+
+/* Sorted runs of this many nodes are made by insertion sort */
+#define POOL_RUN 8
+
+/* Move the elements to the nodes of their place in the queue, each node
+ * getting its 1-based place in prev first. The links are stale afterwards.
+ */
+static void pool_lay_out(struct pnode *n)
+{
+    uint32_t place = 0;
+    for (uint32_t x = n[0].next; x; x = n[x].next)
+        n[x].prev = ++place;
+    for (uint32_t x = 1; x <= place; x++) {
+        while (n[x].prev != x) {
+            uint32_t y = n[x].prev;
+            element_t *e = n[x].e;
+            n[x].e = n[y].e;
+            n[y].e = e;
+            n[x].prev = n[y].prev;
+            n[y].prev = y;
+        }
+    }
+}
+
+static inline element_t **pool_at(struct pnode *n, uint32_t x, bool spare)
+{
+    return spare ? &n[x].spare : &n[x].e;
+}
+
+/* Merge the sorted runs [lo, mid) and [mid, hi) of one array of element
+ * pointers into the other, taking ties from the first run
+ */
+static void pool_merge(struct pnode *n,
+                       uint32_t lo,
+                       uint32_t mid,
+                       uint32_t hi,
+                       bool from_spare)
+{
+    uint32_t a = lo, b = mid;
+    for (uint32_t x = lo; x < hi; x++) {
+        element_t *ea = a < mid ? *pool_at(n, a, from_spare) : NULL;
+        element_t *eb = b < hi ? *pool_at(n, b, from_spare) : NULL;
+        if (!eb || (ea && ele_cmp(ea, eb) <= 0)) {
+            *pool_at(n, x, !from_spare) = ea;
+            a++;
+        } else {
+            *pool_at(n, x, !from_spare) = eb;
+            b++;
+        }
+    }
+}
+
+/* Bottom-up merge sort of the element pointers once the nodes are in queue
+ * order, then the links go in a row again
+ */
+static void pool_sort(queue_t *q)
+{
+    struct pnode *n = pool(q)->node;
+    uint32_t size = q->size, end = size + 1;
+    pool_lay_out(n);
+
+    for (uint32_t lo = 1; lo < end; lo += POOL_RUN) {
+        uint32_t hi = end - lo > POOL_RUN ? lo + POOL_RUN : end;
+        for (uint32_t x = lo + 1; x < hi; x++) {
+            element_t *e = n[x].e;
+            uint32_t y = x;
+            for (; y > lo && ele_cmp(n[y - 1].e, e) > 0; y--)
+                n[y].e = n[y - 1].e;
+            n[y].e = e;
+        }
+    }
+    bool spare = false;
+    for (uint32_t w = POOL_RUN; w < size; w *= 2, spare = !spare) {
+        for (uint32_t lo = 1; lo < end; lo += 2 * w) {
+            uint32_t mid = end - lo > w ? lo + w : end;
+            uint32_t hi = end - mid > w ? mid + w : end;
+            pool_merge(n, lo, mid, hi, spare);
+        }
+    }
+    for (uint32_t x = 1; x < end; x++) {
+        if (spare)
+            n[x].e = n[x].spare;
+        n[x].next = x + 1;
+        n[x].prev = x - 1;
+    }
+    n[size].next = 0;
+    n[0].next = 1;
+    n[0].prev = size;
+}
+
+/* Fisher-Yates over the nodes in array order, which permutes the queue
+ * just as uniformly as going in link order
+ */
+static void pool_shuffle(queue_t *q)
+{
+    struct pnode *n = pool(q)->node;
+    for (uint32_t x = q->size; x > 1; x--) {
+        uint32_t y = shuffle_rand(x) + 1;
+        element_t *e = n[x].e;
+        n[x].e = n[y].e;
+        n[y].e = e;
+    }
+}
+
+static void pool_destroy(queue_t *q)
+{
+    struct pool *p = pool(q);
+    free(p->node);
+    free(p);
+    q->store = NULL;
+}
+
+const struct q_ops pool_ops = {
+    .push_head = pool_push_head,
+    .push_tail = pool_push_tail,
+    .pop_head = pool_pop_head,
+    .pop_tail = pool_pop_tail,
+    .pop_at = pool_pop_at,
+    .first = pool_first,
+    .next = pool_next,
+    .last = pool_last,
+    .set = pool_set,
+    .reverse = pool_reverse,
+    .swap = pool_swap,
+    .sort = pool_sort,
+    .shuffle = pool_shuffle,
+    .destroy = pool_destroy,
+};
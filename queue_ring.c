@@ -0,0 +1,144 @@
+/* Ring buffer queue kind: element pointers in a fixed power-of-two array */
+
+#include <stdlib.h>
+
+#include "harness.h"
+#include "queue_ops.h"
+
+/* Logical position i of the queue is slot[(head + i) & mask] */
+struct ring {
+    unsigned int head, mask;
+    element_t *slot[];
+};
+
+#define ring(q) ((struct ring *) (q)->store)
+#define at(r, i) ((r)->slot[((r)->head + (i)) & (r)->mask])
+
+bool ring_init(queue_t *q, unsigned int capacity)
+{
+    unsigned int cap = 1;
+    while (cap < capacity) {
+        if (cap > RING_MAX_CAPACITY / 2)
+            return false;
+        cap <<= 1;
+    }
+    struct ring *r = malloc(sizeof(struct ring) + cap * sizeof(element_t *));
+    if (!r)
+        return false;
+    r->head = 0;
+    r->mask = cap - 1;
+    q->store = r;
+    return true;
+}
+
+static bool ring_push_head(queue_t *q, element_t *e)
+{
+    struct ring *r = ring(q);
+    if ((unsigned int) q->size > r->mask)
+        return false;
+    r->head = (r->head - 1) & r->mask;
+    r->slot[r->head] = e;
+    return true;
+}
+
+static bool ring_push_tail(queue_t *q, element_t *e)
+{
+    struct ring *r = ring(q);
+    if ((unsigned int) q->size > r->mask)
+        return false;
+    at(r, q->size) = e;
+    return true;
+}
+
+static element_t *ring_pop_head(queue_t *q)
+{
+    struct ring *r = ring(q);
+    element_t *e = r->slot[r->head];
+    r->head = (r->head + 1) & r->mask;
+    return e;
+}
+
+static element_t *ring_pop_tail(queue_t *q)
+{
+    return at(ring(q), q->size - 1);
+}
+
+/* Close the gap by moving the shorter side of the queue */
+static element_t *ring_pop_at(queue_t *q, int i)
+{
+    struct ring *r = ring(q);
+    element_t *e = at(r, i);
+    if (i < q->size / 2) {
+        for (; i > 0; i--)
+            at(r, i) = at(r, i - 1);
+        r->head = (r->head + 1) & r->mask;
+    } else {
+        for (; i < q->size - 1; i++)
+            at(r, i) = at(r, i + 1);
+    }
+    return e;
+}
+
+static element_t *ring_first(queue_t *q, q_iter_t *it)
+{
+    struct ring *r = ring(q);
+    it->pos = r;
+    it->slot = 0;
+    return r->slot[r->head];
+}
+
+static element_t *ring_next(q_iter_t *it)
+{
+    if (++it->slot == q_ctx(it->head)->size)
+        return NULL;
+    return at((struct ring *) it->pos, it->slot);
+}
+
+static element_t *ring_last(queue_t *q)
+{
+    return at(ring(q), q->size - 1);
+}
+
+static void ring_set(q_iter_t *it, element_t *e)
+{
+    at((struct ring *) it->pos, it->slot) = e;
+}
+
+static void ring_lend(queue_t *q)
+{
+    struct ring *r = ring(q);
+    for (int i = 0; i < q->size; i++)
+        list_add_tail(&at(r, i)->list, &q->head);
+}
+
+static void ring_take_back(queue_t *q)
+{
+    struct ring *r = ring(q);
+    unsigned int i = 0;
+    element_t *e;
+    r->head = 0;
+    list_for_each_entry (e, &q->head, list)
+        r->slot[i++] = e;
+    INIT_LIST_HEAD(&q->head);
+}
+
+static void ring_destroy(queue_t *q)
+{
+    free(q->store);
+    q->store = NULL;
+}
+
+const struct q_ops ring_ops = {
+    .push_head = ring_push_head,
+    .push_tail = ring_push_tail,
+    .pop_head = ring_pop_head,
+    .pop_tail = ring_pop_tail,
+    .pop_at = ring_pop_at,
+    .first = ring_first,
+    .next = ring_next,
+    .last = ring_last,
+    .set = ring_set,
+    .lend = ring_lend,
+    .take_back = ring_take_back,
+    .destroy = ring_destroy,
+};
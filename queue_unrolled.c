@@ -0,0 +1,461 @@
+/* Unrolled list queue kind: element pointers packed into blocks */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "queue_ops.h"
+
+/* Slots per block, which makes a block 512 bytes */
+#define UNROLL_SLOTS 61
+
+/* Empty blocks kept for reuse by the ends of the queue */
+#define UNROLL_SPARE 1
+
+/* The elements of a block are slot[first, first + count) */
+struct ublock {
+    struct list_head link;
+    int first, count;
+    element_t *slot[UNROLL_SLOTS];
+};
+
+/* Blocks holding elements in queue order, and empty blocks kept for reuse.
+ * The elements have no list nodes, the queue is reordered by moving element
+ * pointers within and between blocks. Sorting may not free memory, so the
+ * blocks it empties are all kept as spare.
+ */
+struct ustore {
+    struct list_head blocks;
+    struct list_head spare;
+    int nspare;
+};
+
+#define ustore(q) ((struct ustore *) (q)->store)
+#define first_block(s) list_first_entry(&(s)->blocks, struct ublock, link)
+#define last_block(s) list_last_entry(&(s)->blocks, struct ublock, link)
+
+bool unrolled_init(queue_t *q)
+{
+    struct ustore *s = malloc(sizeof(struct ustore));
+    if (!s)
+        return false;
+    INIT_LIST_HEAD(&s->blocks);
+    INIT_LIST_HEAD(&s->spare);
+    s->nspare = 0;
+    q->store = s;
+    return true;
+}
+
+/* Get an empty block, preferably a spare one, and link it after pos */
+static struct ublock *block_get(struct ustore *s, struct list_head *pos)
+{
+    struct ublock *b;
+    if (s->nspare) {
+        b = list_first_entry(&s->spare, struct ublock, link);
+        list_move(&b->link, pos);
+        s->nspare--;
+    } else {
+        b = malloc(sizeof(struct ublock));
+        if (!b)
+            return NULL;
+        list_add(&b->link, pos);
+    }
+    b->count = 0;
+    return b;
+}
+
+/* Unlink a block that became empty */
+static void block_put(struct ustore *s, struct ublock *b)
+{
+    if (s->nspare >= UNROLL_SPARE) {
+        list_del(&b->link);
+        free(b);
+        return;
+    }
+    list_move(&b->link, &s->spare);
+    s->nspare++;
+}
+
+static bool unrolled_push_head(queue_t *q, element_t *e)
+{
+    struct ustore *s = ustore(q);
+    struct ublock *b = list_empty(&s->blocks) ? NULL : first_block(s);
+    if (!b || !b->first) {
+        b = block_get(s, &s->blocks);
+        if (!b)
+            return false;
+        b->first = UNROLL_SLOTS;
+    }
+    b->slot[--b->first] = e;
+    b->count++;
+    return true;
+}
+
+static bool unrolled_push_tail(queue_t *q, element_t *e)
+{
+    struct ustore *s = ustore(q);
+    struct ublock *b = list_empty(&s->blocks) ? NULL : last_block(s);
+    if (!b || b->first + b->count == UNROLL_SLOTS) {
+        b = block_get(s, s->blocks.prev);
+        if (!b)
+            return false;
+        b->first = 0;
+    }
+    b->slot[b->first + b->count++] = e;
+    return true;
+}
+
+static element_t *unrolled_pop_head(queue_t *q)
+{
+    struct ustore *s = ustore(q);
+    struct ublock *b = first_block(s);
+    element_t *e = b->slot[b->first++];
+    if (!--b->count)
+        block_put(s, b);
+    return e;
+}
+
+static element_t *unrolled_pop_tail(queue_t *q)
+{
+    struct ustore *s = ustore(q);
+    struct ublock *b = last_block(s);
+    element_t *e = b->slot[b->first + --b->count];
+    if (!b->count)
+        block_put(s, b);
+    return e;
+}
+
+/* Find the block of element i walking from the nearer end, then close the
+ * gap by moving the shorter side of the block
+ */
+static element_t *unrolled_pop_at(queue_t *q, int i)
+{
+    struct ustore *s = ustore(q);
+    struct ublock *b;
+    if (i < q->size / 2) {
+        list_for_each_entry (b, &s->blocks, link) {
+            if (i < b->count)
+                break;
+            i -= b->count;
+        }
+    } else {
+        i = q->size - 1 - i;
+        for (b = last_block(s); i >= b->count;
+             b = list_entry(b->link.prev, struct ublock, link))
+            i -= b->count;
+        i = b->count - 1 - i;
+    }
+
+    element_t **at = b->slot + b->first + i;
+    element_t *e = *at;
+    if (i < b->count / 2) {
+        memmove(b->slot + b->first + 1, b->slot + b->first,
+                i * sizeof(element_t *));
+        b->first++;
+    } else {
+        memmove(at, at + 1, (b->count - 1 - i) * sizeof(element_t *));
+    }
+    if (!--b->count)
+        block_put(s, b);
+    return e;
+}
+
+static element_t *unrolled_first(queue_t *q, q_iter_t *it)
+{
+    struct ublock *b = first_block(ustore(q));
+    it->pos = b;
+    it->slot = b->first;
+    return b->slot[b->first];
+}
+
+static element_t *unrolled_next(q_iter_t *it)
+{
+    struct ublock *b = it->pos;
+    if (++it->slot == b->first + b->count) {
+        struct ustore *s = ustore(q_ctx(it->head));
+        if (b->link.next == &s->blocks)
+            return NULL;
+        b = list_entry(b->link.next, struct ublock, link);
+        it->pos = b;
+        it->slot = b->first;
+    }
+    return b->slot[it->slot];
+}
+
+static element_t *unrolled_last(queue_t *q)
+{
+    struct ublock *b = last_block(ustore(q));
+    return b->slot[b->first + b->count - 1];
+}
+
+static void unrolled_set(q_iter_t *it, element_t *e)
+{
+    ((struct ublock *) it->pos)->slot[it->slot] = e;
+}
+
+/* Reverse the order of the blocks, then the slots of each block */
+static void unrolled_reverse(queue_t *q)
+{
+    struct ustore *s = ustore(q);
+    struct list_head *node = &s->blocks;
+    do {
+        struct list_head *next = node->next;
+        node->next = node->prev;
+        node->prev = next;
+        node = next;
+    } while (node != &s->blocks);
+
+    struct ublock *b;
+    list_for_each_entry (b, &s->blocks, link) {
+        element_t **lo = b->slot + b->first, **hi = lo + b->count - 1;
+        for (; lo < hi; lo++, hi--) {
+            element_t *e = *lo;
+            *lo = *hi;
+            *hi = e;
+        }
+    }
+}
+
+/* Pairs are swapped in their slots, a pair may straddle two blocks */
+static void unrolled_swap(queue_t *q)
+{
+    struct ublock *b;
+    element_t **held = NULL;
+    list_for_each_entry (b, &ustore(q)->blocks, link) {
+        for (int i = b->first; i < b->first + b->count; i++) {
+            if (!held) {
+                held = &b->slot[i];
+                continue;
+            }
+            element_t *e = *held;
+            *held = b->slot[i];
+            b->slot[i] = e;
+            held = NULL;
+        }
+    }
+}
+
+/* Stable merge sort of the n pointers at v, with room for n / 2 in tmp */
+static void slot_sort(element_t **v, element_t **tmp, int n)
+{
+    if (n < 8) {
+        for (int i = 1; i < n; i++) {
+            element_t *e = v[i];
+            int j = i;
+            for (; j && ele_cmp(v[j - 1], e) > 0; j--)
+                v[j] = v[j - 1];
+            v[j] = e;
+        }
+        return;
+    }
+    int h = n / 2;
+    slot_sort(v, tmp, h);
+    slot_sort(v + h, tmp, n - h);
+    if (ele_cmp(v[h - 1], v[h]) <= 0)
+        return;
+    memcpy(tmp, v, h * sizeof(*v));
+    int a = 0, b = h, x = 0;
+    while (a < h && b < n)
+        v[x++] = ele_cmp(tmp[a], v[b]) <= 0 ? tmp[a++] : v[b++];
+    while (a < h)
+        v[x++] = tmp[a++];
+}
+
+static void slot_shuffle(element_t **v, int n)
+{
+    for (int i = n; i > 1; i--) {
+        int j = shuffle_rand(i);
+        element_t *e = v[i - 1];
+        v[i - 1] = v[j];
+        v[j] = e;
+    }
+}
+
+/* Blocks that merging runs of blocks empties and fills again. The filled
+ * blocks never outnumber the emptied ones by more than the two partly taken
+ * blocks at the heads of the runs, so two more blocks on the stack make up
+ * for them until the merge is done.
+ */
+struct umerge {
+    struct list_head empty;
+    struct ublock extra[2];
+    int nextra; /* extra blocks put to use */
+    bool shuffle;
+};
+
+#define on_stack(m, b) ((b) == &(m)->extra[0] || (b) == &(m)->extra[1])
+
+static element_t *merge_take(struct umerge *m, struct list_head *run)
+{
+    struct ublock *b = list_first_entry(run, struct ublock, link);
+    element_t *e = b->slot[b->first++];
+    if (!--b->count)
+        list_move(&b->link, &m->empty);
+    return e;
+}
+
+static void merge_put(struct umerge *m, struct list_head *out, element_t *e)
+{
+    struct ublock *b =
+        list_empty(out) ? NULL : list_last_entry(out, struct ublock, link);
+    if (!b || b->count == UNROLL_SLOTS) {
+        if (list_empty(&m->empty)) {
+            b = &m->extra[m->nextra++];
+            list_add_tail(&b->link, out);
+        } else {
+            b = list_first_entry(&m->empty, struct ublock, link);
+            list_move_tail(&b->link, out);
+        }
+        b->first = b->count = 0;
+    }
+    b->slot[b->count++] = e;
+}
+
+static size_t run_len(struct list_head *run)
+{
+    size_t n = 0;
+    struct ublock *b;
+    list_for_each_entry (b, run, link)
+        n += b->count;
+    return n;
+}
+
+static inline element_t *run_head(struct list_head *run)
+{
+    struct ublock *b = list_first_entry(run, struct ublock, link);
+    return b->slot[b->first];
+}
+
+/* Merge the runs a and b into out, which takes their blocks. Sorting takes
+ * ties from a, shuffling picks either run as often as it has elements left.
+ */
+static void merge_runs(struct umerge *m,
+                       struct list_head *a,
+                       struct list_head *b,
+                       struct list_head *out)
+{
+    size_t na = m->shuffle ? run_len(a) : 0, nb = m->shuffle ? run_len(b) : 0;
+    while (!list_empty(a) && !list_empty(b)) {
+        bool from_a = m->shuffle ? shuffle_rand(na + nb) < na
+                                 : ele_cmp(run_head(a), run_head(b)) <= 0;
+        if (from_a)
+            na--;
+        else
+            nb--;
+        merge_put(m, out, merge_take(m, from_a ? a : b));
+    }
+    /* Finish the head block of the rest, so that every block the merge
+     * took from is emptied, before the others move over whole
+     */
+    struct list_head *rest = list_empty(a) ? b : a;
+    for (int n = list_first_entry(rest, struct ublock, link)->count; n; n--)
+        merge_put(m, out, merge_take(m, rest));
+    list_splice_tail_init(rest, out);
+}
+/* Sort or shuffle every block on its own, then merge runs of blocks,
+ * bin[k] holding a run made of 2^k blocks that came before the rest
+ */
+static void unrolled_order(queue_t *q, bool shuffle)
+{
+    struct ustore *s = ustore(q);
+    struct umerge m = {.nextra = 0, .shuffle = shuffle};
+    struct list_head bin[32], run, out;
+    element_t *tmp[UNROLL_SLOTS / 2];
+    INIT_LIST_HEAD(&m.empty);
+    list_splice_init(&s->spare, &m.empty);
+    s->nspare = 0;
+    for (int k = 0; k < 32; k++)
+        INIT_LIST_HEAD(&bin[k]);
+    INIT_LIST_HEAD(&run);
+    INIT_LIST_HEAD(&out);
+
+    while (!list_empty(&s->blocks)) {
+        struct ublock *b = first_block(s);
+        list_move(&b->link, &run);
+        if (shuffle)
+            slot_shuffle(b->slot + b->first, b->count);
+        else
+            slot_sort(b->slot + b->first, tmp, b->count);
+        int k = 0;
+        for (; !list_empty(&bin[k]); k++) {
+            merge_runs(&m, &bin[k], &run, &out);
+            list_splice_init(&out, &run);
+        }
+        list_splice_init(&run, &bin[k]);
+    }
+    for (int k = 0; k < 32; k++) {
+        if (list_empty(&bin[k]))
+            continue;
+        if (list_empty(&run)) {
+            list_splice_init(&bin[k], &run);
+        } else {
+            merge_runs(&m, &bin[k], &run, &out);
+            list_splice_init(&out, &run);
+        }
+    }
+    list_splice(&run, &s->blocks);
+
+    /* Done merging, there are as many emptied blocks as extra ones in use */
+    struct ublock *b, *safe;
+    list_for_each_entry (b, &s->blocks, link) {
+        if (!on_stack(&m, b))
+            continue;
+        struct ublock *h;
+        list_for_each_entry (h, &m.empty, link) {
+            if (!on_stack(&m, h))
+                break;
+        }
+        list_del(&h->link);
+        h->first = b->first;
+        h->count = b->count;
+        memcpy(h->slot + h->first, b->slot + b->first,
+               b->count * sizeof(element_t *));
+        list_add(&h->link, &b->link);
+        list_del(&b->link);
+        b = h;
+    }
+    list_for_each_entry_safe (b, safe, &m.empty, link) {
+        if (!on_stack(&m, b)) {
+            list_move(&b->link, &s->spare);
+            s->nspare++;
+        }
+    }
+}
+
+static void unrolled_sort(queue_t *q)
+{
+    unrolled_order(q, false);
+}
+
+static void unrolled_shuffle(queue_t *q)
+{
+    unrolled_order(q, true);
+}
+
+static void unrolled_destroy(queue_t *q)
+{
+    struct ustore *s = ustore(q);
+    struct ublock *b, *safe;
+    list_splice_tail(&s->blocks, &s->spare);
+    list_for_each_entry_safe (b, safe, &s->spare, link)
+        free(b);
+    free(s);
+    q->store = NULL;
+}
+
+const struct q_ops unrolled_ops = {
+    .push_head = unrolled_push_head,
+    .push_tail = unrolled_push_tail,
+    .pop_head = unrolled_pop_head,
+    .pop_tail = unrolled_pop_tail,
+    .pop_at = unrolled_pop_at,
+    .first = unrolled_first,
+    .next = unrolled_next,
+    .last = unrolled_last,
+    .set = unrolled_set,
+    .reverse = unrolled_reverse,
+    .swap = unrolled_swap,
+    .sort = unrolled_sort,
+    .shuffle = unrolled_shuffle,
+    .destroy = unrolled_destroy,
+};
@@ -0,0 +1,34 @@
+# Test shuffle, and that a seed reproduces the same shuffles
+option fail 0
+option malloc 0
+option seed 42
+new
+it a
+it b
+it c
+it d
+it e
+it f
+shuffle
+shuffle
+free
+option seed 42
+new
+it a
+it b
+it c
+it d
+it e
+it f
+shuffle
+rh c
+rh f
+rh d
+rh b
+rh a
+rh e
+it RAND 100000
+shuffle
+size
+sort
+free
@@ -0,0 +1,68 @@
+# Test the MSD radix sort on strings that are prefixes of each other and on
+# prefixes deeper than it recurses, then the top-down merge sort on short,
+# presorted and reversed queues
+option fail 0
+option malloc 0
+option sort 2
+new
+it prefixes
+it prefixer 40
+it pre
+ih prefixed
+it prefix
+ih pref
+sort
+rh pre
+rh pref
+rh prefix
+rh prefixed
+rh prefixer
+rt prefixes
+free
+new
+it xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxb 40
+it xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+ih xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxab
+it xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxa
+sort
+rh xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+rh xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxa
+rh xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxab
+rh xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxb
+rt xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxb
+free
+new
+it RAND 30000
+it 0head
+ih ~tail
+it mole 2000
+sort
+rh 0head
+rt ~tail
+free
+option sort 1
+new
+it only
+sort
+rh only
+it two
+it one
+sort
+rh one
+rh two
+it c
+it a
+it b
+sort
+rh a
+rh b
+rh c
+it RAND 30000
+sort
+reverse
+it 0head
+sort
+rh 0head
+sort
+free
+option sort 0
@@ -0,0 +1,49 @@
+# Test the parallel merge sort on queues cut into segments of uneven length,
+# with the smallest string last, the largest first and duplicates spanning
+# segments, and its fallback to one thread on queues too short to split
+option fail 0
+option malloc 0
+option sort 3
+option threads 4
+new
+ih ~tail
+it RAND 16000
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+new
+ih ~tail
+it RAND 12000
+it dolphin 20000
+it RAND 12000
+it 0head
+sort
+rh 0head
+rt ~tail
+reverse
+sort
+sort
+free
+option threads 3
+new
+ih ~tail
+it RAND 24575
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+option threads 8
+new
+ih ~tail
+it mole 35000
+it RAND 35000
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+option threads 1
+option sort 0
@@ -0,0 +1,53 @@
+# Test the adaptive merge sort on short queues extended by insertion sort,
+# descending runs broken by equal strings, and long runs that merge by
+# galloping
+option fail 0
+option malloc 0
+option sort 4
+new
+it delta
+it charlie
+it charlie
+it bravo
+it alpha
+it echo
+it foxtrot
+it alpha
+sort
+rh alpha
+rh alpha
+rh bravo
+rh charlie
+rh charlie
+rh delta
+rh echo
+rh foxtrot
+free
+new
+ih zebra 5000
+it mole 5000
+sort
+rh mole
+rt zebra
+it aardvark 3000
+it gerbil 3000
+it bear 3000
+it dolphin 3000
+sort
+rh aardvark
+rt zebra
+free
+new
+it RAND 30000
+sort
+reverse
+ih 0head 3000
+it ~tail 3000
+sort
+rh 0head
+rt ~tail
+sort
+reverse
+sort
+free
+option sort 0
@@ -0,0 +1,69 @@
+# Test the external sort on queues as long as the budget and one longer,
+# in two-way merges over many passes when the budget is tiny, and in one
+# merge straight back into queues of every kind
+option fail 0
+option malloc 0
+option extsort 3
+new
+it c
+it b
+it a
+sort
+rh a
+rh b
+rh c
+it d
+it c
+it b
+it a
+sort
+rh a
+rh b
+rh c
+rh d
+ih ~tail
+it RAND 3000
+it mole 500
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+option extsort 1000
+new arena
+ih ~tail
+it RAND 6000
+it mole 2000
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+new pool
+ih ~tail
+it RAND 6000
+it mole 2000
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+new unrolled
+ih ~tail
+it RAND 6000
+it mole 2000
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+new ring 16384
+ih ~tail
+it RAND 6000
+it mole 2000
+it 0head
+sort
+rh 0head
+rt ~tail
+free
+option extsort 0
@@ -0,0 +1,34 @@
+# Test of hash-based delete duplicate on unsorted queues
+option fail 0
+option malloc 0
+new
+hdedup
+ih gerbil
+ih bear
+it dolphin
+it bear
+it meerkat
+it gerbil
+it gerbil
+it squirrel
+hdedup
+size
+rh dolphin
+rh meerkat
+rh squirrel
+it bear
+hdedup
+rh bear
+it RAND 20000
+it vulture 100
+ih RAND 20000
+it vulture
+hdedup
+size
+free
+new unrolled
+it RAND 5000
+it gerbil 3
+ih gerbil
+hdedup
+free
@@ -0,0 +1,36 @@
+# Test of sort unique, which sorts and drops every duplicated string
+option fail 0
+option malloc 0
+new
+sortu
+ih gerbil
+ih bear
+it dolphin
+it bear
+it meerkat
+it gerbil
+it gerbil
+it aardvark
+sortu
+size
+rh aardvark
+rh dolphin
+rh meerkat
+it zebra
+it bear
+it bear
+sortu
+rh zebra
+it RAND 20000
+it vulture 100
+ih RAND 20000
+ih aardvark 2
+sortu
+reverse
+sortu
+free
+new arena
+it RAND 5000
+ih gerbil 3
+sortu
+free
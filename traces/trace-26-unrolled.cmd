@@ -0,0 +1,67 @@
+# Test an unrolled queue across its 61-slot block boundaries: swap, dm and
+# dedup must move elements between blocks, and sort and shuffle must merge
+# runs spanning many blocks
+option fail 0
+option malloc 0
+new unrolled
+it b 60
+it x
+it y
+ih a
+size
+swap
+rh b
+rh a
+rt y
+rt b
+rt x
+size
+free
+new unrolled
+it m 50
+it ~mid
+it m 51
+ih 0head
+dm
+sort
+rh 0head
+rt m
+it m 10
+ih ~mid
+it 0head
+dm
+sort
+rh 0head
+rt ~mid
+free
+new unrolled
+it a 70
+it b
+it c 70
+it d
+dedup
+rh b
+rh d
+size
+it e 100
+it f
+ih e
+hdedup
+rh f
+size
+free
+new unrolled
+it RAND 5000
+ih 0head
+it ~tail
+shuffle
+sort
+rh 0head
+rt ~tail
+ih 0head
+it ~tail
+reverse
+rh ~tail
+rt 0head
+size
+free
@@ -0,0 +1,79 @@
+# Test a ring buffer queue whose head has wrapped past slot 0, so swap, dm,
+# sort, reverse and dedup must follow logical order across the wrap, and
+# then the same ring when it is full
+option fail 0
+option malloc 0
+new ring 8
+it c
+it d
+it e
+ih b
+ih a
+it f
+it g
+it h
+size
+swap
+rh b
+rh a
+rt g
+rt h
+ih y
+ih z
+size
+dm
+sort
+rh d
+rt z
+reverse
+rh y
+rt e
+rh f
+size
+it p
+ih p
+ih o
+it q
+it q
+dedup
+rh o
+size
+free
+new ring 2048
+it RAND 1000
+ih RAND 1000
+ih 0head
+it ~tail
+shuffle
+sort
+rh 0head
+rt ~tail
+free
+option fail 10
+new ring 3
+ih gerbil
+it meerkat
+ih bear
+it dolphin
+it vulture
+ih squirrel
+size
+rh bear
+it vulture
+rt vulture
+rh gerbil
+it squirrel
+ih aardvark
+reverse
+rh squirrel
+rh dolphin
+rh meerkat
+rh aardvark
+it RAND 4
+it RAND
+sort
+free
+new ring
+it RAND 1000
+sort
+free
@@ -0,0 +1,46 @@
+# Test a pool queue as its node array grows past 64 and 128 nodes and
+# shrinks back, with head and tail pushes interleaved so that array order
+# and queue order differ
+option fail 0
+option malloc 0
+new pool
+it a 40
+ih b 40
+ih 0head
+it ~tail
+size
+swap
+rh b
+rh 0head
+rt a
+rt ~tail
+ih 0head
+it m 100
+it ~tail
+size
+dm
+reverse
+rh ~tail
+rt 0head
+ih 0head
+it ~tail
+sort
+dedup
+size
+rh 0head
+rt ~tail
+it RAND 300
+ih 0head
+it ~tail
+shuffle
+sort
+rh 0head
+rt ~tail
+free
+new pool
+it RAND 20000
+ih gerbil 100
+dm
+sort
+reverse
+free
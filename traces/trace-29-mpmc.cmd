@@ -0,0 +1,7 @@
+# Test the lock-free queue with several producers and consumers
+option fail 0
+option malloc 0
+mpmc 1 1 1
+mpmc 2 2 2000
+mpmc 1 3 1000
+mpmc 3 1 1000
@@ -0,0 +1,7 @@
+# Test streaming strings from one thread to another through a ring
+option fail 0
+option malloc 0
+spsc 1 1 1
+spsc 5000 1 2
+spsc 5000 64 16
+spsc 20000 8 64
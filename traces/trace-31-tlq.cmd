@@ -0,0 +1,5 @@
+# Test the two-lock queue against a queue behind one mutex
+option fail 0
+option malloc 0
+tlq 1 1
+tlq 4 2000
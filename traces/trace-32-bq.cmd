@@ -0,0 +1,7 @@
+# Test the blocking queue with bounded and unbounded capacity
+option fail 0
+option malloc 0
+bq 1 1 1 0
+bq 3 1 2000 1
+bq 2 2 2000 16
+bq 1 3 2000 0
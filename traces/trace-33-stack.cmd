@@ -0,0 +1,5 @@
+# Test the lock-free stacks against a stack behind one mutex
+option fail 0
+option malloc 0
+stack 1 1
+stack 4 2000
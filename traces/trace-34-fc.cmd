@@ -0,0 +1,15 @@
+# Test sharing the queue among threads through flat combining
+option fail 0
+option malloc 0
+new
+fc 2 100
+it RAND 100
+fc 4 2000
+free
+new ring 4
+it RAND 4
+fc 2 100
+free
+new pool
+fc 2 100
+free
@@ -0,0 +1,5 @@
+# Test the sharded queue against a queue behind one mutex
+option fail 0
+option malloc 0
+shard 2 1
+shard 4 2000
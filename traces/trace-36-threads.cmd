@@ -0,0 +1,36 @@
+# Test queue operations and their checkers on the fork-join pool
+option fail 0
+option malloc 0
+option threads 4
+new
+it RAND 40000
+it gerbil 1000
+ih RAND 40000
+ih gerbil
+hdedup
+sort
+it bear 2
+reverse
+sort
+dedup
+free
+new pool
+it RAND 70000
+it dolphin 100
+ih squirrel 3
+hdedup
+option sort 3
+sort
+sortu
+option threads 2
+shuffle
+sort
+free
+option threads 1
+new
+it RAND 70000
+it dolphin 2
+hdedup
+option sort 0
+sort
+free